@@ -0,0 +1,249 @@
+/*******************************************************************************************
+*  bench: microbenchmarks for cpick's render and input hot paths
+*
+*  Builds main.c without its main() and times the pieces of a frame in a hidden
+*  window, over a scripted sweep of slices. Run with `make bench && ./bench`, or
+*  `./bench --cpu` to skip the shader path.
+*
+*  See COPYING for copyright
+*
+********************************************************************************************/
+
+#define CPICK_NO_MAIN
+#include "main.c"
+
+struct samples {
+	const char *name;
+	double *t; // seconds per call
+	int n;
+	int cap;
+};
+
+void add_sample(struct samples *s, double t)
+{
+	if (s->n == s->cap) {
+		s->cap = s->cap ? 2*s->cap : 256;
+		s->t = realloc(s->t, s->cap*sizeof(double));
+	}
+	s->t[s->n++] = t;
+}
+
+double percentile(struct samples *s, double p)
+{
+	int i = p*(s->n - 1) + 0.5;
+	return s->t[i];
+}
+
+void report(struct samples *s)
+{
+	if (s->n == 0) {
+		return;
+	}
+	qsort(s->t, s->n, sizeof(double), cmp_double);
+	printf("%-28s %7d %11.3f %11.3f %11.3f %11.3f\n", s->name, s->n,
+		   percentile(s, 0.5)*1e6, percentile(s, 0.9)*1e6, percentile(s, 0.99)*1e6, s->t[s->n-1]*1e6);
+	free(s->t);
+}
+
+// Scripted state for step i: sweep fixed_value across each axis in turn, with the
+// cursor walking the diagonal.
+void script_state(struct state *st, int i)
+{
+	st->which_fixed = (i / 256) % 3;
+	st->fixed_value = i % 256;
+	st->x_value = (i*7) % 256;
+	st->y_value = (i*13) % 256;
+}
+
+#define FRAMES (3*256)
+
+// Time one drawing function per frame. The batch is flushed inside the timed region
+// so the cost of turning draw calls into GL work is counted, but the swap isn't.
+#define TIME_DRAW(samples, frames, setup, call) \
+	for (int i = 0; i < (frames); i++) { \
+		setup; \
+		BeginDrawing(); \
+		ClearBackground(BLACK); \
+		double t0 = now_seconds(); \
+		call; \
+		rlDrawRenderBatchActive(); \
+		add_sample(&(samples), now_seconds() - t0); \
+		EndDrawing(); \
+	}
+
+int main(int argc, char **argv)
+{
+	bool force_cpu = argc > 1 && !strcmp(argv[1], "--cpu");
+
+	struct state *st = (struct state *) calloc(1, sizeof(struct state));
+	st->screenWidth = BASE_W;
+	st->screenHeight = BASE_H;
+	st->text_color = WHITE;
+	palette_init(&st->palette, NULL);
+
+	SetConfigFlags(FLAG_WINDOW_HIDDEN);
+	SetTraceLogLevel(LOG_WARNING);
+	InitWindow(st->screenWidth, st->screenHeight, "CPick bench");
+	SetTargetFPS(0);
+	st->text_font = LoadFont_NotoSansMonoTtf();
+	load_render_resources(st, force_cpu);
+	if (st->renderer == RENDER_SHADER) {
+		// the cached CPU path is benchmarked either way
+		st->slices = &st->slice_cache;
+		slice_pool_init(st->slices);
+	}
+
+	printf("%-28s %7s %11s %11s %11s %11s\n", "us per call", "n", "p50", "p90", "p99", "max");
+
+	// current_color: too fast to time one call, so time a whole square's worth
+	struct samples cc = { "current_color" };
+	volatile unsigned char sink = 0;
+	for (int i = 0; i < FRAMES; i++) {
+		script_state(st, i);
+		double t0 = now_seconds();
+		for (int y = 0; y < 256; y++) {
+			st->y_value = y;
+			for (int x = 0; x < 256; x++) {
+				st->x_value = x;
+				sink ^= current_color(st).g;
+			}
+		}
+		add_sample(&cc, (now_seconds() - t0) / (256*256));
+	}
+	report(&cc);
+
+	// slice fill kernels, CPU only
+	struct {
+		const char *name;
+		void (*fn)(Color *, int, int, int, int);
+	} kernels[] = {
+		{ "fill_slice_generic", fill_slice_generic },
+#if defined(__x86_64__) || defined(__i386__)
+		{ "fill_slice_sse2", fill_slice_sse2 },
+		{ __builtin_cpu_supports("avx2") ? "fill_slice_avx2" : NULL, fill_slice_avx2 },
+#elif defined(__ARM_NEON)
+		{ "fill_slice_neon", fill_slice_neon },
+#endif
+		{ "fill_slice_hsv", fill_slice_hsv },
+		{ "fill_slice_hsl", fill_slice_hsl },
+		{ "fill_slice_oklab", fill_slice_oklab },
+		{ "fill_slice_oklch", fill_slice_oklch },
+	};
+	for (int k = 0; k < (int) (sizeof(kernels)/sizeof(kernels[0])); k++) {
+		if (!kernels[k].name) {
+			continue;
+		}
+		struct samples s = { kernels[k].name };
+		for (int i = 0; i < FRAMES; i++) {
+			script_state(st, i);
+			double t0 = now_seconds();
+			kernels[k].fn(st->slices->pixels, st->which_fixed, st->fixed_value, 0, 256);
+			add_sample(&s, now_seconds() - t0);
+		}
+		report(&s);
+	}
+
+	struct samples par = { "fill_slice_parallel" };
+	for (int i = 0; i < FRAMES; i++) {
+		script_state(st, i);
+		double t0 = now_seconds();
+		fill_slice_parallel(st->slices->pixels, st->which_fixed, st->fixed_value);
+		add_sample(&par, now_seconds() - t0);
+	}
+	report(&par);
+	printf("(%d worker threads, %d-row bands)\n", workers.nthreads, fill_slice_grain);
+
+	// --bits tiles: one 256x256 half float tile, the unit the deep view is filled in
+	struct deep_tiles dt = { .format = PIXELFORMAT_UNCOMPRESSED_R16G16B16A16,
+							 .pixels = malloc(DEEP_TILE*DEEP_TILE*4*sizeof(uint16_t)) };
+	int deep_spaces[] = { SPACE_RGB, SPACE_HSV, SPACE_OKLCH };
+	const char *deep_names[] = { "deep tile rgb", "deep tile hsv", "deep tile oklch" };
+	for (int k = 0; k < 3; k++) {
+		struct samples s = { deep_names[k] };
+		for (int i = 0; i < FRAMES/8; i++) {
+			struct deep_fill_job job = { &dt, deep_spaces[k], i % 3, i*97, 1024, 2, 0, 0 };
+			double t0 = now_seconds();
+			parallel_for(&workers, DEEP_TILE, 16, deep_fill_band, &job);
+			add_sample(&s, now_seconds() - t0);
+		}
+		report(&s);
+	}
+	free(dt.pixels);
+
+	// gradient square variants
+	struct samples direct = { "draw_gradient_n" };
+	TIME_DRAW(direct, 32, script_state(st, i*8),
+			  draw_gradient_n(150, 40, 2, st->which_fixed, st->fixed_value));
+	report(&direct);
+
+	struct samples miss = { "draw_gradient_cached miss" };
+	TIME_DRAW(miss, FRAMES, (script_state(st, i), slice_pool_invalidate(st->slices)),
+			  draw_gradient_cached(150, 40, 512, st));
+	report(&miss);
+
+	// slider drag: the pool prefetches ahead of fixed_value
+	struct samples drag = { "draw_gradient_cached drag" };
+	st->val_slider_dragging = true;
+	slice_pool_invalidate(st->slices);
+	TIME_DRAW(drag, FRAMES, script_state(st, i),
+			  draw_gradient_cached(150, 40, 512, st));
+	st->val_slider_dragging = false;
+	report(&drag);
+
+	struct samples clean = { "draw_gradient_cached hit" };
+	TIME_DRAW(clean, FRAMES, ,
+			  draw_gradient_cached(150, 40, 512, st));
+	report(&clean);
+
+	if (st->renderer == RENDER_SHADER) {
+		struct samples shader = { "draw_gradient_shader" };
+		TIME_DRAW(shader, FRAMES, script_state(st, i),
+				  draw_gradient_shader(150, 40, 512, 512, st));
+		report(&shader);
+	}
+
+	// nearest-name lookup, for colors all over the cube
+	struct samples names = { "palette_nearest" };
+	for (int i = 0; i < FRAMES; i++) {
+		Color c = { (i*7) % 256, (i*13) % 256, (i*29) % 256, 255 };
+		float d;
+		double t0 = now_seconds();
+		sink ^= palette_nearest(&st->palette, c, &d)->rgb.g;
+		add_sample(&names, now_seconds() - t0);
+	}
+	report(&names);
+
+	struct samples axes = { "draw_axes" };
+	struct layout l = get_layout(st);
+	TIME_DRAW(axes, FRAMES, script_state(st, i),
+			  draw_axes(st, &l));
+	report(&axes);
+
+	// full frames, including the swap
+	struct samples ui = { "draw_ui_and_respond_input" };
+	struct samples frame = { "frame (incl. EndDrawing)" };
+	for (int i = 0; i < FRAMES; i++) {
+		script_state(st, i);
+		double t0 = now_seconds();
+		BeginDrawing();
+		draw_ui_and_respond_input(st);
+		rlDrawRenderBatchActive();
+		double t1 = now_seconds();
+		EndDrawing();
+		add_sample(&ui, t1 - t0);
+		add_sample(&frame, now_seconds() - t0);
+	}
+	report(&ui);
+	report(&frame);
+
+	printf("renderer: %s\n", st->renderer == RENDER_SHADER ? "shader" : "cpu");
+
+	if (st->renderer == RENDER_SHADER) {
+		slice_pool_free(st->slices);
+	}
+	unload_render_resources(st);
+	palette_free(&st->palette);
+	CloseWindow();
+	(void) sink;
+	return 0;
+}
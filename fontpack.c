@@ -0,0 +1,263 @@
+/*******************************************************************************************
+*  fontpack: build-time helper for cpick
+*
+*  Inflates the atlas embedded in noto_sans_mono_ttf.h, repacks the glyphs into a
+*  tight atlas and prints it as an uncompressed header with the same
+*  LoadFont_NotoSansMonoTtf() entry point. Built and run by `make FONT=raw`.
+*
+*  With --sdf it prints a signed distance field atlas instead, at half the size,
+*  for `make FONT=sdf`: main.c draws it through a small shader that keeps edges
+*  sharp at any scale.
+*
+*  See COPYING for copyright
+*
+********************************************************************************************/
+
+#include <stdio.h> // printf
+#include <stdlib.h> // calloc, qsort
+#include <string.h> // memcpy, strcmp
+#include <math.h> // floorf, ceilf, sqrtf
+#include "raylib.h" // DecompressData
+#include "noto_sans_mono_ttf.h"
+
+#define SRC_W 1024
+#define SRC_H 1024
+#define GLYPHS 95
+#define PAD 4 // font.glyphPadding in noto_sans_mono_ttf.h
+#define DST_W 512
+
+// The SDF atlas is at half the source size, which keeps the 52px advance whole.
+#define SDF_SIZE 60
+#define SDF_SCALE (120/SDF_SIZE)
+#define SDF_SPREAD 4 // distance range either side of an edge, in atlas texels; also the padding
+
+const Rectangle *pack_recs; // what by_height sorts on
+
+int by_height(const void *a, const void *b)
+{
+	float ha = pack_recs[*(const int *) a].height;
+	float hb = pack_recs[*(const int *) b].height;
+	return (ha < hb) - (ha > hb);
+}
+
+// Shelf packing into a DST_W wide atlas, tallest glyphs first so each shelf wastes
+// little height. Takes the glyph sizes in recs and fills in their positions, leaving
+// pad texels around each; returns the atlas height.
+int pack(Rectangle *recs, int pad)
+{
+	int order[GLYPHS];
+	for (int i = 0; i < GLYPHS; i++) {
+		order[i] = i;
+	}
+	pack_recs = recs;
+	qsort(order, GLYPHS, sizeof(int), by_height);
+	int x = 0, y = 0, shelf_h = 0;
+	for (int k = 0; k < GLYPHS; k++) {
+		int i = order[k];
+		int w = recs[i].width + 2*pad;
+		int h = recs[i].height + 2*pad;
+		if (x + w > DST_W) {
+			x = 0;
+			y += shelf_h;
+			shelf_h = 0;
+		}
+		recs[i].x = x + pad;
+		recs[i].y = y + pad;
+		x += w;
+		shelf_h = h > shelf_h ? h : shelf_h;
+	}
+	return y + shelf_h;
+}
+
+// Whether source pixel x, y of glyph rectangle r is inked; outside r is empty.
+int inked(const unsigned char *src, Rectangle r, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= r.width || y >= r.height) {
+		return 0;
+	}
+	// GRAY_ALPHA, the coverage is in the alpha byte
+	return src[2*((int) (r.y + y)*SRC_W + (int) r.x + x) + 1] >= 128;
+}
+
+// Signed distance from point (px, py), in glyph rectangle r's source pixels, to the
+// nearest edge: positive inside. Brute force over the pixels within reach, which is
+// plenty fast for 95 glyphs at build time.
+float edge_distance(const unsigned char *src, Rectangle r, float px, float py)
+{
+	int reach = (SDF_SPREAD + 1)*SDF_SCALE;
+	int cx = floorf(px), cy = floorf(py);
+	// the sample sits on a pixel corner: call it inside when most of the 2x2 around it is
+	int in = inked(src, r, cx-1, cy-1) + inked(src, r, cx, cy-1) + inked(src, r, cx-1, cy) + inked(src, r, cx, cy) >= 2;
+	float best = reach;
+	for (int y = cy - reach; y <= cy + reach; y++) {
+		for (int x = cx - reach; x <= cx + reach; x++) {
+			if (inked(src, r, x, y) != in) {
+				float dx = x + 0.5f - px, dy = y + 0.5f - py;
+				float d = sqrtf(dx*dx + dy*dy) - 0.5f; // the edge is half a pixel short of the center
+				best = d < best ? d : best;
+			}
+		}
+	}
+	best = best < 0 ? 0 : best;
+	return in ? best : -best;
+}
+
+// Prints the SDF atlas header. Each atlas texel covers SDF_SCALE x SDF_SCALE source
+// pixels, aligned to the glyph's origin so the offsets stay exact, and stores
+// 128 + distance*127/SDF_SPREAD.
+int print_sdf(const unsigned char *src)
+{
+	Rectangle recs[GLYPHS];
+	GlyphInfo glyphs[GLYPHS];
+	for (int i = 0; i < GLYPHS; i++) {
+		Rectangle r = fontRecs_NotoSansMonoTtf[i];
+		GlyphInfo g = fontGlyphs_NotoSansMonoTtf[i];
+		int x0 = floorf((float) g.offsetX / SDF_SCALE), y0 = floorf((float) g.offsetY / SDF_SCALE);
+		int x1 = ceilf((g.offsetX + r.width) / SDF_SCALE), y1 = ceilf((g.offsetY + r.height) / SDF_SCALE);
+		recs[i] = (Rectangle) { 0, 0, x1 - x0, y1 - y0 };
+		glyphs[i] = (GlyphInfo) { g.value, x0, y0, g.advanceX / SDF_SCALE, { 0 } };
+	}
+	int dst_h = pack(recs, SDF_SPREAD);
+
+	unsigned char *dst = calloc(DST_W*dst_h, 1);
+	for (int i = 0; i < GLYPHS; i++) {
+		Rectangle r = fontRecs_NotoSansMonoTtf[i];
+		GlyphInfo g = fontGlyphs_NotoSansMonoTtf[i];
+		for (int ty = -SDF_SPREAD; ty < recs[i].height + SDF_SPREAD; ty++) {
+			for (int tx = -SDF_SPREAD; tx < recs[i].width + SDF_SPREAD; tx++) {
+				// texel center, in source pixels from the glyph rectangle's corner
+				float px = (glyphs[i].offsetX + tx + 0.5f)*SDF_SCALE - g.offsetX;
+				float py = (glyphs[i].offsetY + ty + 0.5f)*SDF_SCALE - g.offsetY;
+				float d = edge_distance(src, r, px, py) / SDF_SCALE;
+				float v = 128 + d*127/SDF_SPREAD;
+				dst[(int) (recs[i].y + ty)*DST_W + (int) recs[i].x + tx] = v < 0 ? 0 : v > 255 ? 255 : v + 0.5f;
+			}
+		}
+	}
+
+	printf("// Generated by fontpack --sdf from noto_sans_mono_ttf.h, do not edit.\n");
+	printf("// Signed distance field GRAYSCALE atlas: 128 is the glyph edge, and each step\n");
+	printf("// of 127/SDF_SPREAD_NOTOSANSMONOTTF is one texel further inside or out.\n\n");
+	printf("#define SDF_ATLAS_WIDTH_NOTOSANSMONOTTF %d\n", DST_W);
+	printf("#define SDF_ATLAS_HEIGHT_NOTOSANSMONOTTF %d\n", dst_h);
+	printf("#define SDF_SPREAD_NOTOSANSMONOTTF %d\n\n", SDF_SPREAD);
+	printf("static unsigned char fontData_NotoSansMonoTtf[%d] = {", DST_W*dst_h);
+	for (int i = 0; i < DST_W*dst_h; i++) {
+		printf("%s0x%02x,", i % 20 ? " " : "\n    ", dst[i]);
+	}
+	printf("\n};\n\n");
+
+	printf("static const Rectangle fontRecs_NotoSansMonoTtf[%d] = {\n", GLYPHS);
+	for (int i = 0; i < GLYPHS; i++) {
+		printf("    { %d, %d, %d , %d },\n", (int) recs[i].x, (int) recs[i].y, (int) recs[i].width, (int) recs[i].height);
+	}
+	printf("};\n\n");
+
+	printf("static const GlyphInfo fontGlyphs_NotoSansMonoTtf[%d] = {\n", GLYPHS);
+	for (int i = 0; i < GLYPHS; i++) {
+		printf("    { %d, %d, %d, %d, { 0 }},\n", glyphs[i].value, glyphs[i].offsetX, glyphs[i].offsetY, glyphs[i].advanceX);
+	}
+	printf("};\n\n");
+
+	printf("static Font LoadFont_NotoSansMonoTtf(void)\n"
+		   "{\n"
+		   "    Font font = { 0 };\n"
+		   "\n"
+		   "    font.baseSize = %d;\n"
+		   "    font.glyphCount = %d;\n"
+		   "    font.glyphPadding = %d;\n"
+		   "\n"
+		   "    Image imFont = { fontData_NotoSansMonoTtf, SDF_ATLAS_WIDTH_NOTOSANSMONOTTF, SDF_ATLAS_HEIGHT_NOTOSANSMONOTTF, 1, 1 };\n"
+		   "    font.texture = LoadTextureFromImage(imFont);\n"
+		   "    SetTextureFilter(font.texture, TEXTURE_FILTER_BILINEAR);\n"
+		   "\n"
+		   "    // WARNING: This font data must not be unloaded\n"
+		   "    font.recs = (Rectangle *) fontRecs_NotoSansMonoTtf;\n"
+		   "    font.glyphs = (GlyphInfo *) fontGlyphs_NotoSansMonoTtf;\n"
+		   "\n"
+		   "    return font;\n"
+		   "}\n", SDF_SIZE, GLYPHS, SDF_SPREAD);
+
+	free(dst);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int size = 0;
+	unsigned char *src = DecompressData(fontData_NotoSansMonoTtf, COMPRESSED_DATA_SIZE_FONT_NOTOSANSMONOTTF, &size);
+	if (!src || size != SRC_W*SRC_H*2) {
+		fprintf(stderr, "fontpack: unexpected atlas size %d\n", size);
+		return 1;
+	}
+	if (argc > 1 && !strcmp(argv[1], "--sdf")) {
+		int rc = print_sdf(src);
+		MemFree(src);
+		return rc;
+	}
+
+	Rectangle recs[GLYPHS];
+	memcpy(recs, fontRecs_NotoSansMonoTtf, sizeof(recs));
+	int dst_h = pack(recs, PAD);
+
+	unsigned char *dst = calloc(DST_W*dst_h, 2);
+	for (int i = 0; i < GLYPHS; i++) {
+		Rectangle r = fontRecs_NotoSansMonoTtf[i];
+		int sx = r.x - PAD, sy = r.y - PAD;
+		int dx = recs[i].x - PAD, dy = recs[i].y - PAD;
+		int w = r.width + 2*PAD;
+		int h = r.height + 2*PAD;
+		for (int row = 0; row < h; row++) {
+			if (sy + row < 0 || sy + row >= SRC_H) continue;
+			for (int col = 0; col < w; col++) {
+				if (sx + col < 0 || sx + col >= SRC_W) continue;
+				memcpy(dst + 2*((dy + row)*DST_W + dx + col), src + 2*((sy + row)*SRC_W + sx + col), 2);
+			}
+		}
+	}
+
+	printf("// Generated by fontpack from noto_sans_mono_ttf.h, do not edit.\n");
+	printf("// Uncompressed GRAY_ALPHA atlas, uploaded as-is with no DecompressData() step.\n\n");
+	printf("#define RAW_ATLAS_WIDTH_NOTOSANSMONOTTF %d\n", DST_W);
+	printf("#define RAW_ATLAS_HEIGHT_NOTOSANSMONOTTF %d\n\n", dst_h);
+	printf("static unsigned char fontData_NotoSansMonoTtf[%d] = {", DST_W*dst_h*2);
+	for (int i = 0; i < DST_W*dst_h*2; i++) {
+		printf("%s0x%02x,", i % 20 ? " " : "\n    ", dst[i]);
+	}
+	printf("\n};\n\n");
+
+	printf("static const Rectangle fontRecs_NotoSansMonoTtf[%d] = {\n", GLYPHS);
+	for (int i = 0; i < GLYPHS; i++) {
+		printf("    { %d, %d, %d , %d },\n", (int) recs[i].x, (int) recs[i].y, (int) recs[i].width, (int) recs[i].height);
+	}
+	printf("};\n\n");
+
+	printf("static const GlyphInfo fontGlyphs_NotoSansMonoTtf[%d] = {\n", GLYPHS);
+	for (int i = 0; i < GLYPHS; i++) {
+		GlyphInfo g = fontGlyphs_NotoSansMonoTtf[i];
+		printf("    { %d, %d, %d, %d, { 0 }},\n", g.value, g.offsetX, g.offsetY, g.advanceX);
+	}
+	printf("};\n\n");
+
+	printf("static Font LoadFont_NotoSansMonoTtf(void)\n"
+		   "{\n"
+		   "    Font font = { 0 };\n"
+		   "\n"
+		   "    font.baseSize = 120;\n"
+		   "    font.glyphCount = %d;\n"
+		   "    font.glyphPadding = %d;\n"
+		   "\n"
+		   "    Image imFont = { fontData_NotoSansMonoTtf, RAW_ATLAS_WIDTH_NOTOSANSMONOTTF, RAW_ATLAS_HEIGHT_NOTOSANSMONOTTF, 1, 2 };\n"
+		   "    font.texture = LoadTextureFromImage(imFont);\n"
+		   "\n"
+		   "    // WARNING: This font data must not be unloaded\n"
+		   "    font.recs = (Rectangle *) fontRecs_NotoSansMonoTtf;\n"
+		   "    font.glyphs = (GlyphInfo *) fontGlyphs_NotoSansMonoTtf;\n"
+		   "\n"
+		   "    return font;\n"
+		   "}\n", GLYPHS, PAD);
+
+	free(dst);
+	MemFree(src);
+	return 0;
+}
@@ -7,17 +7,724 @@
 *
 ********************************************************************************************/
 
-#include <stdio.h> // sprintf
+#include <stdio.h> // snprintf
 #include <stdlib.h> // malloc
+#include <string.h> // strcmp
+#include <strings.h> // strcasecmp
+#include <sys/stat.h> // mkdir
+#include <errno.h> // EEXIST
 #include <sys/param.h> // MIN, MAX
+#include <stdint.h> // uint32_t
 #include <math.h> // round
+#include <time.h> // clock_gettime
+#include <pthread.h> // slice workers
+#include <unistd.h> // sysconf
+#include <signal.h> // sigaction
+#include <sys/socket.h> // --daemon
+#include <sys/un.h> // sockaddr_un
+#include <sys/time.h> // struct timeval
+#include <sys/mman.h> // mmap
+#include <sys/file.h> // flock
+#include <fcntl.h> // open
+#include <stddef.h> // offsetof
+#include <limits.h> // PATH_MAX
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // SSE2, AVX2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#ifdef CPICK_X11
+#include <sys/shm.h> // shmget
+// Xlib has its own Font, which raylib's would clash with
+#define Font X11Font
+#include <X11/Xlib.h>
+#include <X11/Xutil.h> // XGetPixel
+#include <X11/cursorfont.h> // XC_crosshair
+#include <X11/extensions/XShm.h>
+#undef Font
+#endif
 #include "raylib.h" // everything CamelCase except...
+#include "rlgl.h" // rlSetBlendFactorsSeparate
+#ifdef CPICK_FONT_RAW
+#include "noto_sans_mono_raw.h" // LoadFont_NotoSansMonoTtf, generated by fontpack
+#elif defined(CPICK_FONT_SDF)
+#include "noto_sans_mono_sdf.h" // LoadFont_NotoSansMonoTtf, generated by fontpack --sdf
+#else
 #include "noto_sans_mono_ttf.h" // LoadFont_NotoSansMonoTtf
+#endif
+#include "named_colors.h" // css_colors
+
+/*
+ * raylib draw calls, counted for the frame-timing HUD. The UI draws through these;
+ * the HUD itself calls raylib directly, after the count is taken.
+ */
+int draw_call_count;
+
+static inline void hud_draw_pixel(int x, int y, Color c)
+{
+	draw_call_count++;
+	DrawPixel(x, y, c);
+}
+
+static inline void hud_draw_rect(int x, int y, int w, int h, Color c)
+{
+	draw_call_count++;
+	DrawRectangle(x, y, w, h, c);
+}
+
+static inline void hud_draw_rect_lines(Rectangle rec, float thick, Color c)
+{
+	draw_call_count++;
+	DrawRectangleLinesEx(rec, thick, c);
+}
+
+static inline void hud_draw_circle(Vector2 center, float radius, Color c)
+{
+	draw_call_count++;
+	DrawCircleV(center, radius, c);
+}
+
+static inline void hud_draw_text(Font font, const char *text, Vector2 pos, float size, float spacing, Color tint)
+{
+	draw_call_count++;
+	DrawTextEx(font, text, pos, size, spacing, tint);
+}
+
+static inline void hud_draw_texture(Texture2D tex, Vector2 pos, float rotation, float scale, Color tint)
+{
+	draw_call_count++;
+	DrawTextureEx(tex, pos, rotation, scale, tint);
+}
+
+static inline void hud_draw_texture_rec(Texture2D tex, Rectangle src, Vector2 pos, Color tint)
+{
+	draw_call_count++;
+	DrawTextureRec(tex, src, pos, tint);
+}
+
+static inline void hud_draw_texture_pro(Texture2D tex, Rectangle src, Rectangle dest, Vector2 origin, float rotation,
+										Color tint)
+{
+	draw_call_count++;
+	DrawTexturePro(tex, src, dest, origin, rotation, tint);
+}
+
+double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Stages of a frame, as timed by the HUD (F3)
+enum stage {
+	STAGE_INPUT, // applying the frame's input to the state
+	STAGE_AXES, // clear + chrome layer: axes, buttons and slider track
+	STAGE_GRADIENT,
+	STAGE_CURSOR,
+	STAGE_SLIDER,
+	STAGE_READOUT,
+	STAGE_HISTORY,
+	STAGE_SWAP, // EndDrawing: batch flush, swap, vsync wait, event polling
+	STAGE_COUNT
+};
+
+const char *stage_names[STAGE_COUNT] = { "input", "axes", "gradient", "cursor", "slider", "readout", "history", "swap" };
+
+#define HUD_FRAMES 120
+struct hud {
+	bool visible;
+	// rolling window, in seconds
+	double frame_t[HUD_FRAMES]; // start to start
+	double stage_t[HUD_FRAMES][STAGE_COUNT];
+	int draw_calls[HUD_FRAMES];
+	double input_age[HUD_FRAMES]; // newest input sample to swap done
+	double wait[HUD_FRAMES]; // slept before the frame to start it late, see struct pacing
+	// EndDrawing waited for events, so the swap and input age are mostly idle time;
+	// these and the next frame's frame_t are left out of the percentiles
+	bool idle[HUD_FRAMES];
+	bool woke[HUD_FRAMES]; // frame_t spans the previous frame's event wait
+	int frame; // frames recorded so far; frame % HUD_FRAMES is the current slot
+	double frame_start;
+	double mark;
+};
+
+/*
+ * Frame pacing. raylib's frame cap sleeps after the swap, so by the time a frame
+ * shows, the input it was drawn from is up to a frame old. Instead the cap is off
+ * and the swap waits for the vblank (FLAG_VSYNC_HINT); while frames run back to
+ * back, each one first sleeps until just enough before the next vblank to be
+ * drawn, then samples input and draws. The period is the monitor's, so 120-240 Hz
+ * displays get a frame every refresh while something moves, and when nothing does
+ * EndDrawing waits for events as before.
+ */
+#define PACE_DEFAULT_HZ 60 // if the monitor doesn't say
+#define PACE_MARGIN 0.0015 // s left before the vblank for the driver and compositor
+#define PACE_SAFETY 1.5 // times the estimated frame cost
+#define PACE_SWAP_BLOCKED 0.0005 // s; a swap that took longer returned at a vblank
+
+enum pace_mode {
+	PACE_IDLE, // waiting for events: the next frame goes as soon as one comes
+	PACE_PACED,
+	PACE_UNCAPPED, // --low-latency while held: no vsync, no sleeping
+	PACE_COUNT
+};
+
+const char *pace_names[PACE_COUNT] = { "idle", "paced", "uncapped" };
+
+struct pacing {
+	int hz;
+	double period;
+	double vblank; // the last frame's vblank, seen or predicted
+	double target; // the vblank the current frame is drawn for
+	double work; // frame cost, sampling input to swap: follows rises at once, drops slowly
+	double wait; // slept before the current frame
+	enum pace_mode mode; // how the last frame ended, and so how the next one starts
+};
+
+struct pacing pacing;
+
+// Again whenever frames start back to back, in case the window changed monitors.
+void pacing_refresh_rate(void)
+{
+	int hz = GetMonitorRefreshRate(GetCurrentMonitor());
+	pacing.hz = hz > 0 ? hz : PACE_DEFAULT_HZ;
+	pacing.period = 1.0 / pacing.hz;
+}
+
+// Before sampling a frame's input: sleep until it has just enough time left to
+// make the next vblank.
+void pacing_wait(void)
+{
+	struct pacing *p = &pacing;
+	p->wait = 0;
+	if (p->mode != PACE_PACED) {
+		return;
+	}
+	double now = now_seconds();
+	// the vblank after the last frame's, or the first one that is still to come
+	p->target = p->vblank + p->period*MAX(1, floor((now - p->vblank)/p->period) + 1);
+	double start = p->target - PACE_SAFETY*p->work - PACE_MARGIN;
+	if (start > now) {
+		p->wait = start - now;
+		WaitTime(p->wait);
+	}
+}
+
+// On from InitWindow, except for --replay --fast; --low-latency turns it off while
+// the pointer is held.
+void set_vsync(bool on)
+{
+	if (on) {
+		SetWindowState(FLAG_VSYNC_HINT);
+	} else {
+		ClearWindowState(FLAG_VSYNC_HINT);
+	}
+}
+
+// After EndDrawing: start is when the frame sampled its input, swap when it called
+// EndDrawing, end when that returned.
+void pacing_frame_done(double start, double swap, double end, enum pace_mode mode)
+{
+	struct pacing *p = &pacing;
+	double work = swap - start;
+	p->work = MAX(work, 0.95*p->work + 0.05*work);
+	// without vsync (or if it isn't honored), the swap doesn't wait and frames
+	// keep to the predicted vblanks
+	p->vblank = p->mode != PACE_PACED || end - swap > PACE_SWAP_BLOCKED ? end : p->target;
+	if (mode == PACE_PACED && p->mode != PACE_PACED) {
+		pacing_refresh_rate();
+	}
+	p->mode = mode;
+}
+
+/*
+ * Pointer and key input, sampled with timestamps whenever raylib's event queue is
+ * polled (by EndDrawing, and again by us right before drawing), and consumed once
+ * per frame. raylib only remembers the latest poll, so press edges and key presses
+ * are accumulated here until the frame has used them.
+ */
+#define INPUT_SAMPLES 32
+#define INPUT_KEYS 16
+
+struct input_sample {
+	double t;
+	Vector2 pos;
+	bool down;
+};
+
+struct input {
+	struct input_sample samples[INPUT_SAMPLES]; // since the last frame, oldest first
+	int nsamples;
+	bool pressed; // left button went down since the last frame...
+	Vector2 press_pos; // ...here
+	int keys[INPUT_KEYS];
+	int nkeys;
+	float wheel; // scrolled since the last frame
+	// latest state
+	Vector2 pos;
+	bool down;
+	double t;
+};
+
+void input_collect(struct input *in)
+{
+	struct input_sample s = { now_seconds(), GetMousePosition(), IsMouseButtonDown(0) };
+	if (in->nsamples == INPUT_SAMPLES) {
+		memmove(in->samples, in->samples + 1, (INPUT_SAMPLES - 1)*sizeof(s));
+		in->nsamples--;
+	}
+	in->samples[in->nsamples++] = s;
+	if (IsMouseButtonPressed(0) && !in->pressed) {
+		in->pressed = true;
+		in->press_pos = s.pos;
+	}
+	in->wheel += GetMouseWheelMove();
+	int key;
+	while ((key = GetKeyPressed()) != 0) {
+		if (in->nkeys < INPUT_KEYS) {
+			in->keys[in->nkeys++] = key;
+		}
+	}
+	in->pos = s.pos;
+	in->down = s.down;
+	in->t = s.t;
+}
+
+// Poll for new events without blocking, then sample.
+void input_poll(struct input *in)
+{
+	DisableEventWaiting();
+	PollInputEvents();
+	input_collect(in);
+}
+
+bool input_key_pressed(struct input *in, int key)
+{
+	for (int i = 0; i < in->nkeys; i++) {
+		if (in->keys[i] == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void input_consumed(struct input *in)
+{
+	in->nsamples = 0;
+	in->pressed = false;
+	in->nkeys = 0;
+	in->wheel = 0;
+}
+
+// Move the pointer positions dx to the right, into a --panels panel's coordinates.
+void input_translate(struct input *in, float dx)
+{
+	for (int i = 0; i < in->nsamples; i++) {
+		in->samples[i].pos.x += dx;
+	}
+	in->press_pos.x += dx;
+	in->pos.x += dx;
+}
+
+/*
+ * --record FILE saves the input each frame is drawn from, and --replay FILE feeds
+ * it back instead of polling, at the recorded pace or (with --fast) as fast as
+ * frames can be drawn, then prints the frame times and final state. A recording
+ * is a header and one fixed-size frame record per frame, times relative to its
+ * start, and only replays in a build with the same struct input. Dropped images
+ * and screen samples aren't input, so drops and the eyedropper are off while
+ * recording or replaying, as is --extract.
+ */
+#define RECORDING_MAGIC "CPICKRP1"
+
+struct recording_header {
+	char magic[8];
+	uint32_t frame_size; // sizeof(struct recording_frame)
+	int32_t deep_bits;
+};
+
+struct recording_frame {
+	double t; // frame start
+	int32_t width;
+	int32_t height;
+	struct input input;
+};
+
+struct recording {
+	FILE *f; // NULL: off
+	double origin; // now_seconds() at t = 0
+	bool fast; // replay: don't wait for the recorded frame times
+	bool done; // replay: out of frames
+	double *frame_t; // replay: each frame, from drawing through EndDrawing
+	int n;
+	int cap;
+};
+
+void input_shift(struct input *in, double dt)
+{
+	for (int i = 0; i < in->nsamples; i++) {
+		in->samples[i].t += dt;
+	}
+	in->t += dt;
+}
+
+/*
+ * Screen eyedropper capture: only the MAG_N x MAG_N pixels around the pointer are
+ * read each frame. On X11 (make EYEDROPPER=x11) that is one XShmGetImage into a
+ * segment shared with the server, falling back to XGetImage on displays without
+ * MIT-SHM; the pointer is grabbed so the click that picks comes to us. Other
+ * platforms have no capture backend yet, and capture_open() says so.
+ */
+#define MAG_N 15 // odd, so the pointer has a center pixel
+
+struct capture {
+	Color pixels[MAG_N*MAG_N];
+	int center_x; // the pointer's pixel, off center near screen edges
+	int center_y;
+#ifdef CPICK_X11
+	Display *dpy;
+	Window root;
+	XImage *img; // shared image, if use_shm
+	XShmSegmentInfo shm;
+	bool use_shm;
+	Cursor cursor;
+#endif
+};
+
+#ifdef CPICK_X11
+int mask_channel(unsigned long p, unsigned long mask)
+{
+	int shift = __builtin_ctzl(mask);
+	return ((p & mask) >> shift) * 255 / (mask >> shift);
+}
+
+// Set by capture_x_error while the XShm segment is attached.
+bool capture_x_failed;
+
+int capture_x_error(Display *dpy, XErrorEvent *e)
+{
+	(void) dpy;
+	(void) e;
+	capture_x_failed = true;
+	return 0;
+}
+
+// XShm can be advertised and still not attach, as over ssh -X or to a remote
+// server, where XShmAttach fails with BadAccess; Xlib's default handler would
+// exit on that.
+bool capture_open_shm(struct capture *c, int screen)
+{
+	c->img = XShmCreateImage(c->dpy, DefaultVisual(c->dpy, screen), DefaultDepth(c->dpy, screen),
+							 ZPixmap, NULL, &c->shm, MAG_N, MAG_N);
+	if (!c->img) {
+		return false;
+	}
+	c->shm.shmid = shmget(IPC_PRIVATE, c->img->bytes_per_line*c->img->height, IPC_CREAT | 0600);
+	if (c->shm.shmid < 0) {
+		XDestroyImage(c->img);
+		return false;
+	}
+	c->shm.shmaddr = c->img->data = shmat(c->shm.shmid, NULL, 0);
+	if (c->shm.shmaddr == (char *) -1) {
+		shmctl(c->shm.shmid, IPC_RMID, NULL);
+		XDestroyImage(c->img);
+		return false;
+	}
+	c->shm.readOnly = False;
+	capture_x_failed = false;
+	XErrorHandler old_handler = XSetErrorHandler(capture_x_error);
+	Status attached = XShmAttach(c->dpy, &c->shm);
+	XSync(c->dpy, False);
+	XSetErrorHandler(old_handler);
+	// removed once both sides detach
+	shmctl(c->shm.shmid, IPC_RMID, NULL);
+	if (!attached || capture_x_failed) {
+		XDestroyImage(c->img);
+		shmdt(c->shm.shmaddr);
+		return false;
+	}
+	return true;
+}
+
+bool capture_open(struct capture *c)
+{
+	if (!c->dpy) {
+		c->dpy = XOpenDisplay(NULL);
+		if (!c->dpy) {
+			TraceLog(LOG_WARNING, "CPICK: eyedropper: can't open the X display");
+			return false;
+		}
+		int screen = DefaultScreen(c->dpy);
+		c->root = RootWindow(c->dpy, screen);
+		c->use_shm = XShmQueryExtension(c->dpy) && capture_open_shm(c, screen);
+		c->cursor = XCreateFontCursor(c->dpy, XC_crosshair);
+		TraceLog(LOG_INFO, "CPICK: eyedropper: %s", c->use_shm ? "XShm" : "XGetImage");
+	}
+	int r = XGrabPointer(c->dpy, c->root, False, ButtonPressMask, GrabModeAsync, GrabModeAsync,
+						 None, c->cursor, CurrentTime);
+	if (r != GrabSuccess) {
+		TraceLog(LOG_WARNING, "CPICK: eyedropper: couldn't grab the pointer");
+		return false;
+	}
+	return true;
+}
+
+void capture_sample(struct capture *c)
+{
+	Window root_ret, child;
+	int rx, ry, wx, wy;
+	unsigned int buttons;
+	XQueryPointer(c->dpy, c->root, &root_ret, &child, &rx, &ry, &wx, &wy, &buttons);
+	int screen = DefaultScreen(c->dpy);
+	int x0 = MIN(MAX(rx - MAG_N/2, 0), DisplayWidth(c->dpy, screen) - MAG_N);
+	int y0 = MIN(MAX(ry - MAG_N/2, 0), DisplayHeight(c->dpy, screen) - MAG_N);
+	XImage *img = c->img;
+	if (c->use_shm) {
+		XShmGetImage(c->dpy, c->root, img, x0, y0, AllPlanes);
+	} else {
+		img = XGetImage(c->dpy, c->root, x0, y0, MAG_N, MAG_N, AllPlanes, ZPixmap);
+		if (!img) {
+			return;
+		}
+	}
+	for (int y = 0; y < MAG_N; y++) {
+		for (int x = 0; x < MAG_N; x++) {
+			unsigned long p = XGetPixel(img, x, y);
+			c->pixels[y*MAG_N + x] = (Color) {
+				mask_channel(p, img->red_mask), mask_channel(p, img->green_mask), mask_channel(p, img->blue_mask), 255
+			};
+		}
+	}
+	if (!c->use_shm) {
+		XDestroyImage(img);
+	}
+	c->center_x = rx - x0;
+	c->center_y = ry - y0;
+}
+
+// 1 if the grabbed pointer was left-clicked since the last call, -1 for any other
+// button, else 0.
+int capture_poll_click(struct capture *c)
+{
+	int click = 0;
+	while (XPending(c->dpy)) {
+		XEvent ev;
+		XNextEvent(c->dpy, &ev);
+		if (ev.type == ButtonPress && !click) {
+			click = ev.xbutton.button == Button1 ? 1 : -1;
+		}
+	}
+	return click;
+}
+
+void capture_release(struct capture *c)
+{
+	XUngrabPointer(c->dpy, CurrentTime);
+	XFlush(c->dpy);
+}
+
+void capture_close(struct capture *c)
+{
+	if (!c->dpy) {
+		return;
+	}
+	if (c->use_shm) {
+		XShmDetach(c->dpy, &c->shm);
+		XDestroyImage(c->img);
+		shmdt(c->shm.shmaddr);
+	}
+	XFreeCursor(c->dpy, c->cursor);
+	XCloseDisplay(c->dpy);
+	c->dpy = NULL;
+}
+#else
+bool capture_open(struct capture *c)
+{
+	TraceLog(LOG_WARNING, "CPICK: eyedropper: no screen capture in this build (make EYEDROPPER=x11)");
+	return false;
+}
+
+void capture_sample(struct capture *c) {}
+int capture_poll_click(struct capture *c) { return 0; }
+void capture_release(struct capture *c) {}
+void capture_close(struct capture *c) {}
+#endif
+
+enum renderer {
+	RENDER_CPU, // slices filled on the CPU and cached in the slice pool
+	RENDER_SHADER, // slice computed per fragment by gradient_shader
+};
+
+// A laid-out run of text: the glyph quads DrawTextEx would emit, computed once.
+#define TEXT_CACHE_MAX 64
+struct text_cache {
+	char text[TEXT_CACHE_MAX];
+	bool valid;
+	Vector2 pos;
+	float size;
+	int nquads;
+	Rectangle src[TEXT_CACHE_MAX];
+	Rectangle dst[TEXT_CACHE_MAX];
+};
+
+/*
+ * Named colors: the user's --palette file followed by the CSS colors, for the
+ * "nearest name" line under the readout. Lookups go through a uniform grid over
+ * OKLab, so a query only measures the colors in the few cells around it instead
+ * of the whole palette (rgb.txt alone is ~750 names).
+ */
+#define PALETTE_NAME_LEN 32
+#define PALETTE_GRID 16 // cells per axis
+#define PALETTE_CELLS (PALETTE_GRID*PALETTE_GRID*PALETTE_GRID)
+#define PALETTE_CELL_MIN (2*OK_AB_MAX / PALETTE_GRID) // narrowest cell side, a and b
+
+struct named_color {
+	char name[PALETTE_NAME_LEN];
+	Color rgb;
+	float lab[3];
+};
+
+struct palette {
+	struct named_color *colors;
+	int n;
+	int cap;
+	// colors in cell c are items[start[c]] to items[start[c+1] - 1], in file order
+	int start[PALETTE_CELLS + 1];
+	int *items;
+};
+
+/*
+ * Pick history: fixed-size records in a file that is mapped, not read, so opening
+ * it costs the same however many years of picks it holds and drawing the strip
+ * only touches the pages of the visible swatches. The file is grown in doubling
+ * steps ahead of count, and a pick is a single record write plus the count bump.
+ * Records are in native byte order.
+ */
+#define HISTORY_MAGIC "CPICKHI1"
+#define HISTORY_MIN_CAP 1024 // records preallocated in a new file
+
+struct history_header {
+	char magic[8];
+	uint32_t record_size;
+	uint32_t reserved;
+	uint64_t count; // records in use, the rest of the file is preallocated
+};
+
+struct history_record {
+	int64_t time; // unix time, ms
+	uint8_t r, g, b;
+	uint8_t space; // enum space, and the slice position that produced the color:
+	uint8_t which_fixed;
+	uint8_t fixed_value;
+	uint8_t x_value;
+	uint8_t y_value;
+	uint8_t reserved[8];
+};
+_Static_assert(sizeof(struct history_record) == 24, "history records are 24 bytes on disk");
+
+struct history {
+	int fd;
+	struct history_header *map; // NULL: no history
+	size_t size; // mapped bytes
+	struct history_record *records;
+	int scroll; // swatches skipped from the newest
+};
+
+/*
+ * High bit-depth mode (--bits 10, 12 or 16): each component moves in 2^bits steps
+ * and is converted in float. A full slice is no longer one texture (a 16-bit
+ * slice is 65536^2), so the square shows a zoomable view of it made of 256^2
+ * tiles from a quadtree: level L splits the slice into 2^L x 2^L tiles, each a
+ * sample of every 2^(bits-8-L)th step, and the view uses the level where its
+ * width is one to two tiles. Tiles are cached in float textures (half float at
+ * 10 bits, which can hold that many steps, full float above) and only the
+ * visible ones are ever filled or uploaded.
+ */
+#define DEEP_TILE 256 // texels per side
+#define DEEP_TILES 24 // a view covers at most 3x3 tiles
+#define DEEP_MIN_VIEW 64 // steps across the square at the deepest zoom
+
+struct deep_tile {
+	Texture2D tex;
+	int axis; // slice_axis(), -1: empty
+	int fixed; // step of the fixed component
+	int level;
+	int tx;
+	int ty;
+	unsigned long last_used;
+};
+
+struct deep_tiles {
+	struct deep_tile tiles[DEEP_TILES];
+	unsigned long clock;
+	int format; // PIXELFORMAT_UNCOMPRESSED_R16G16B16A16 or R32G32B32A32
+	void *pixels; // scratch for one tile in that format
+};
+
+/*
+ * Slice texture pool for the CPU renderer: an LRU set of slice textures keyed by
+ * (slice_axis, fixed_value). While the slider is dragged a worker thread fills the
+ * slices the slider is heading towards, and the render thread uploads finished ones
+ * a couple per frame, so by the time the slider gets there the frame just binds an
+ * existing texture.
+ */
+#define SLICE_POOL_SIZE 16
+#define PREFETCH_JOBS 6 // buffers the worker can fill ahead
+#define PREFETCH_AHEAD 4 // slices ahead of the slider, plus one behind
+#define PREFETCH_UPLOADS 2 // finished prefetches uploaded per frame
+
+struct slice_entry {
+	Texture2D tex;
+	int axis; // slice_axis(), -1: empty
+	int fixed_value;
+	unsigned long last_used;
+};
+
+enum job_state { JOB_FREE, JOB_QUEUED, JOB_FILLING, JOB_DONE };
+
+struct prefetch_job {
+	enum job_state state;
+	int axis;
+	int fixed_value;
+	Color *pixels;
+};
+
+struct slice_pool {
+	struct slice_entry entries[SLICE_POOL_SIZE];
+	unsigned long clock;
+	int filter;
+	Color *pixels; // scratch for synchronous fills on a miss
+	// worker side, all guarded by lock
+	struct prefetch_job jobs[PREFETCH_JOBS];
+	pthread_t worker;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	bool quit;
+};
+
+/*
+ * 3D view of the RGB cube (V): a 64^3 lattice of colors, ray marched per fragment
+ * on one quad like gradient_fs, so the cost is per pixel of the square rather than
+ * per point. Lattice points on the current slice, in whatever space it is taken
+ * through, are drawn as solid cells; the rest are small translucent dots you can
+ * see the slice through. A ring marks the current color, in front of everything.
+ */
+#define CUBE_N 64
+#define CUBE_DIST_MIN 1.2f // camera distance from the cube's center; its corners are 0.87 out
+#define CUBE_DIST_MAX 6.f
+#define CUBE_FOCAL 2.75f // about a 40 degree field of view
+
+enum cube_uniform {
+	CUBE_EYE, CUBE_RIGHT, CUBE_UP, CUBE_FWD, CUBE_SPACE, CUBE_WHICH_FIXED, CUBE_FIXED_VALUE,
+	CUBE_MARKER, CUBE_MARKER_COLOR, CUBE_UNIFORMS
+};
 
 struct state {
 	int screenWidth;
 	int screenHeight;
-	int which_fixed; // red(0), green(1) or blue(2)
+	int space; // enum space
+	int which_fixed; // fixed component of the space: red(0), green(1) or blue(2) for RGB
 	bool val_slider_dragging;
 	// these two represent the same thing...
 	int fixed_value; // 0-255
@@ -26,203 +733,4468 @@ struct state {
 	int y_value;
 	Color text_color;
 	Font text_font;
+	Shader text_shader;
+	bool text_sdf; // text_font is a distance field drawn through text_shader
+	// CPU renderer: cached slices (slice_cache, or panel 0's for the other
+	// --panels), and which way the slider was last moving
+	struct slice_pool slice_cache;
+	struct slice_pool *slices;
+	int prefetch_last_value;
+	int prefetch_dir;
+	// quad the gradient shader draws on
+	Texture2D slice_tex;
+	enum renderer renderer;
+	Shader gradient_shader;
+	int which_fixed_loc;
+	int space_loc;
+	int gamut_lut_loc;
+	Texture2D gamut_tex; // gamut_atlas, for the shader
+	int contrast_min_loc;
+	int contrast_ref_loc;
+	int fixed_value_loc;
+	// V: the square shows the RGB cube, orbited by dragging in it
+	bool cube_view;
+	Shader cube_shader; // id 0 if unavailable
+	int cube_locs[CUBE_UNIFORMS];
+	float cube_yaw;
+	float cube_pitch;
+	float cube_dist;
+	bool cube_dragging;
+	Vector2 cube_drag_pos;
+	// retained layer for the static UI, valid while its key fields match
+	RenderTexture2D chrome;
+	bool chrome_valid;
+	int chrome_w;
+	int chrome_h;
+	int chrome_axis;
+	Color chrome_text_color;
+	// color read out, laid out again only when its text or position changes
+	struct text_cache readout;
+	// nearest named color, looked up again only when the picked color changes
+	struct palette palette;
+	const struct named_color *name_match;
+	float name_dist;
+	Color name_color;
+	struct text_cache name_text;
+	struct history history;
+	bool square_held; // a pick in the square, recorded on release
+	// contrast overlay: shades the slice where it meets contrast_levels[level]
+	// against contrast_ref (shader renderer only)
+	int contrast_level; // 0: off
+	Color contrast_ref;
+	struct text_cache contrast_text;
+	struct hud hud;
+	struct input input;
+	// screen eyedropper
+	bool eyedropper;
+	Color eyedropper_saved; // color to go back to on cancel
+	struct capture capture;
+	Texture2D mag_tex;
+	bool mag_tex_loaded;
+	bool low_latency; // no vsync while the pointer is held
+	bool uncapped;
+	bool continuous; // redraw even when idle
+	bool accepted; // Enter: print the color (or send it to the --daemon client)
+	// --bits: the components in 2^deep_bits steps, see struct deep_tiles
+	int deep_bits; // 0: off
+	int deep_steps;
+	int deep[3]; // per component, 0 to deep_steps - 1
+	Color deep_key; // the 8-bit components deep was last synced with, and the space
+	float view_x; // visible part of the slice, as fractions of it
+	float view_y;
+	float view_span;
+	int view_axis; // the slice axis the view is of
+	struct deep_tiles tiles;
+	struct recording record;
+	struct recording replay;
+	int extract_k; // colors taken from an image dropped on the window
+	struct history_record *extracted; // the last image's palette, in front of the history
+	int nextracted;
+	// --panels: one of several pickers side by side, drawn translated to panel_x
+	// with screenWidth as its own width
+	bool panel;
+	int panel_x;
+	bool focused; // gets the window's input and dropped files
 };
 
-char *color_strings[3] = { "R", "G", "B" };
+// Color spaces a slice can be taken through. The state holds the three components
+// of the current space as 0-255 steps; for hue that is 256 steps around the circle.
+enum space { SPACE_RGB, SPACE_HSV, SPACE_HSL, SPACE_OKLAB, SPACE_OKLCH, SPACE_COUNT };
+
+const char *space_names[SPACE_COUNT] = { "RGB", "HSV", "HSL", "OKLab", "OKLCH" };
+char *color_strings[SPACE_COUNT][3] = {
+	{ "R", "G", "B" }, { "H", "S", "V" }, { "H", "S", "L" }, { "L", "a", "b" }, { "L", "C", "h" }
+};
+
+// The channel mapping of a slice, defined once: with channel wf fixed, x runs along
+// the next channel and y along the one after (so R fixed is { fixed, x, y }, G fixed
+// is { y, fixed, x } and B fixed is { x, y, fixed }).
+#define CHANNEL_FIXED(wf) (wf)
+#define CHANNEL_X(wf) (((wf)+1)%3)
+#define CHANNEL_Y(wf) (((wf)+2)%3)
+
+// Indexed stores rather than a branch; with a constant wf it folds to a plain
+// struct initializer. wf is taken mod 3, so a bad one can't index past c.
+static inline Color slice_color(int wf, int fixed_val, int x, int y)
+{
+	unsigned char c[4];
+	wf = (unsigned) wf % 3;
+	c[CHANNEL_FIXED(wf)] = fixed_val;
+	c[CHANNEL_X(wf)] = x;
+	c[CHANNEL_Y(wf)] = y;
+	c[3] = 255;
+	return (Color) { c[0], c[1], c[2], c[3] };
+}
+
+// Fully saturated color of each hue step (hue i is i/256 of a turn), so HSV and HSL
+// come down to a couple of multiply-adds per channel. Filled by init_hue_lut().
+float hue_lut[256][3];
+
+// Fully saturated color at hue turns (0-1).
+void hue_ramp(float turns, float q[3])
+{
+	const float n[3] = { 5, 3, 1 };
+	for (int c = 0; c < 3; c++) {
+		float k = fmodf(n[c] + turns*6, 6);
+		q[c] = 1 - fmaxf(0, fminf(fminf(k, 4 - k), 1));
+	}
+}
+
+void init_hue_lut(void)
+{
+	for (int i = 0; i < 256; i++) {
+		hue_ramp(i / 256.f, hue_lut[i]);
+	}
+}
+
+// Unquantized HSV/HSL, all components 0-1 (hue in turns). x is V for HSV, L for
+// HSL.
+void hsx_to_rgb(bool hsl, const float hsx[3], float rgb[3])
+{
+	float q[3];
+	hue_ramp(hsx[0], q);
+	for (int c = 0; c < 3; c++) {
+		if (hsl) {
+			rgb[c] = hsx[2] + (1 - fabsf(2*hsx[2] - 1))*hsx[1]*(q[c] - 0.5f);
+		} else {
+			rgb[c] = hsx[2]*(1 - hsx[1]*(1 - q[c]));
+		}
+	}
+}
+
+void rgb_to_hsx(bool hsl, const float rgb[3], float hsx[3])
+{
+	float r = rgb[0], g = rgb[1], b = rgb[2];
+	float max = fmaxf(r, fmaxf(g, b)), min = fminf(r, fminf(g, b)), d = max - min;
+	float h = 0; // sixths of a turn
+	if (d > 0) {
+		if (max == r) {
+			h = fmodf((g - b) / d + 6, 6);
+		} else if (max == g) {
+			h = (b - r) / d + 2;
+		} else {
+			h = (r - g) / d + 4;
+		}
+	}
+	hsx[0] = h / 6;
+	if (!hsl) {
+		hsx[1] = max > 0 ? d / max : 0;
+		hsx[2] = max;
+		return;
+	}
+	hsx[2] = (max + min) / 2;
+	hsx[1] = d > 0 ? fminf(1, d / (1 - fabsf(2*hsx[2] - 1))) : 0;
+}
+
+// c holds { h, s, v } as laid out by slice_color
+static inline Color hsv_to_rgb(Color c)
+{
+	const float *q = hue_lut[c.r];
+	float s = c.g / 255.f, v = c.b;
+	return (Color) { v*(1 - s*(1 - q[0])) + 0.5f, v*(1 - s*(1 - q[1])) + 0.5f, v*(1 - s*(1 - q[2])) + 0.5f, 255 };
+}
+
+// c holds { h, s, l }
+static inline Color hsl_to_rgb(Color c)
+{
+	const float *q = hue_lut[c.r];
+	float l = c.b;
+	float chroma = (255 - fabsf(2*l - 255)) * (c.g / 255.f);
+	return (Color) { l + chroma*(q[0] - 0.5f) + 0.5f, l + chroma*(q[1] - 0.5f) + 0.5f,
+					 l + chroma*(q[2] - 0.5f) + 0.5f, 255 };
+}
+
+/*
+ * OKLab and OKLCH. Components are 0-255 steps: L spans 0-1, a and b span
+ * +-OK_AB_MAX and chroma 0-OK_C_MAX, and hue is 256 steps around the circle like
+ * HSV's. Much of that box is outside sRGB, so slices are drawn from a 64^3 grid
+ * over (L, a, b) holding the clipped sRGB color, with alpha marking how far inside
+ * the gamut the point is (see gamut_margin), trilinearly interpolated. It is
+ * built once by init_gamut_lut(): as floats for the CPU path, and as an 8x8
+ * RGBA8 atlas of 64x64 (a, b) tiles that the shader samples as a 2D texture.
+ * Only the current color gets the exact math (ok_to_rgb).
+ */
+#define OK_AB_MAX 0.4f
+#define OK_C_MAX 0.4f
+#define GAMUT_N 64
+#define GAMUT_ATLAS_W (8*GAMUT_N)
+
+float gamut_grid[GAMUT_N*GAMUT_N*GAMUT_N][4]; // [L][b][a], 0-255
+Color gamut_atlas[GAMUT_ATLAS_W*GAMUT_ATLAS_W];
+float hue_cos[256];
+float srgb_linear[256]; // srgb_decode of each 8-bit value
+float srgb_encode_lut[4097]; // srgb_encode at i/4096, for srgb_encode_fast: within 2e-5
+float hue_sin[256];
+
+void oklab_to_linear(const float lab[3], float rgb[3])
+{
+	float l = lab[0] + 0.3963377774f*lab[1] + 0.2158037573f*lab[2];
+	float m = lab[0] - 0.1055613458f*lab[1] - 0.0638541728f*lab[2];
+	float s = lab[0] - 0.0894841775f*lab[1] - 1.2914855480f*lab[2];
+	l = l*l*l;
+	m = m*m*m;
+	s = s*s*s;
+	rgb[0] = 4.0767416621f*l - 3.3077115913f*m + 0.2309699292f*s;
+	rgb[1] = -1.2684380046f*l + 2.6097574011f*m - 0.3413193965f*s;
+	rgb[2] = -0.0041960863f*l - 0.7034186147f*m + 1.7076147010f*s;
+}
+
+void linear_to_oklab(const float rgb[3], float lab[3])
+{
+	float l = cbrtf(0.4122214708f*rgb[0] + 0.5363299433f*rgb[1] + 0.0514459929f*rgb[2]);
+	float m = cbrtf(0.2119034982f*rgb[0] + 0.6806995451f*rgb[1] + 0.1073969566f*rgb[2]);
+	float s = cbrtf(0.0883024619f*rgb[0] + 0.2817188376f*rgb[1] + 0.6299787005f*rgb[2]);
+	lab[0] = 0.2104542553f*l + 0.7936177850f*m - 0.0040720468f*s;
+	lab[1] = 1.9779984951f*l - 2.4285922050f*m + 0.4505937099f*s;
+	lab[2] = 0.0259040371f*l + 0.7827717662f*m - 0.8086757660f*s;
+}
+
+float srgb_encode(float x)
+{
+	x = fminf(1, fmaxf(0, x));
+	return x <= 0.0031308f ? 12.92f*x : 1.055f*powf(x, 1/2.4f) - 0.055f;
+}
+
+float srgb_decode(float x)
+{
+	return x <= 0.04045f ? x/12.92f : powf((x + 0.055f)/1.055f, 2.4f);
+}
+
+bool in_gamut(const float rgb[3])
+{
+	const float eps = 1e-4f;
+	return rgb[0] >= -eps && rgb[0] <= 1 + eps && rgb[1] >= -eps && rgb[1] <= 1 + eps &&
+		   rgb[2] >= -eps && rgb[2] <= 1 + eps;
+}
+
+// c holds { L, a, b } or { L, C, h } as laid out by slice_color
+static inline void ok_to_lab(int space, Color c, float lab[3])
+{
+	lab[0] = c.r / 255.f;
+	if (space == SPACE_OKLAB) {
+		lab[1] = (c.g / 255.f - 0.5f) * 2*OK_AB_MAX;
+		lab[2] = (c.b / 255.f - 0.5f) * 2*OK_AB_MAX;
+	} else {
+		float chroma = c.g / 255.f * OK_C_MAX;
+		lab[1] = chroma*hue_cos[c.b];
+		lab[2] = chroma*hue_sin[c.b];
+	}
+}
+
+// Distance in OKLab between lab and its clipped sRGB color, which goes in clipped.
+float clip_error(const float lab[3], float clipped[3])
+{
+	float rgb[3], back[3];
+	oklab_to_linear(lab, rgb);
+	for (int k = 0; k < 3; k++) {
+		clipped[k] = fminf(1, fmaxf(0, rgb[k]));
+	}
+	linear_to_oklab(clipped, back);
+	return sqrtf((lab[0] - back[0])*(lab[0] - back[0]) + (lab[1] - back[1])*(lab[1] - back[1]) +
+				 (lab[2] - back[2])*(lab[2] - back[2]));
+}
+
+// Nearest in-gamut sRGB color, as CSS Color 4 maps gamut: reduce chroma at constant
+// lightness and hue until plain clipping is within a just noticeable difference.
+Color oklab_to_rgb(const float lab[3])
+{
+	const float jnd = 0.02f;
+	float rgb[3];
+	oklab_to_linear(lab, rgb);
+	if (!in_gamut(rgb) && clip_error(lab, rgb) >= jnd) {
+		float lo = 0, hi = 1;
+		while (hi - lo > 1e-4f) {
+			float t = (lo + hi) / 2;
+			float mapped[3] = { lab[0], lab[1]*t, lab[2]*t };
+			oklab_to_linear(mapped, rgb);
+			if (in_gamut(rgb)) {
+				lo = t;
+				continue;
+			}
+			float e = clip_error(mapped, rgb);
+			if (e < jnd) {
+				if (jnd - e < 1e-4f) {
+					break;
+				}
+				lo = t;
+			} else {
+				hi = t;
+			}
+		}
+	}
+	return (Color) { srgb_encode(rgb[0])*255 + 0.5f, srgb_encode(rgb[1])*255 + 0.5f,
+					 srgb_encode(rgb[2])*255 + 0.5f, 255 };
+}
+
+Color ok_to_rgb(int space, Color c)
+{
+	float lab[3];
+	ok_to_lab(space, c, lab);
+	return oklab_to_rgb(lab);
+}
+
+void rgb_to_oklab(Color rgb, float lab[3])
+{
+	float lin[3] = { srgb_linear[rgb.r], srgb_linear[rgb.g], srgb_linear[rgb.b] };
+	linear_to_oklab(lin, lab);
+}
+
+// WCAG 2 relative luminance and contrast ratio
+float relative_luminance(Color c)
+{
+	return 0.2126f*srgb_linear[c.r] + 0.7152f*srgb_linear[c.g] + 0.0722f*srgb_linear[c.b];
+}
+
+float contrast_ratio(float y1, float y2)
+{
+	return (MAX(y1, y2) + 0.05f) / (MIN(y1, y2) + 0.05f);
+}
+
+const struct {
+	const char *name;
+	float ratio;
+} contrast_levels[] = {
+	{ NULL, 0 }, // off
+	{ "AA", 4.5 },
+	{ "AAA", 7 },
+};
+#define CONTRAST_LEVELS ((int) (sizeof(contrast_levels)/sizeof(contrast_levels[0])))
+
+// How far inside the gamut rgb (linear) is, negative outside, as the alpha stored
+// in the gamut grid. Unlike a plain in/out flag it interpolates to a usable edge.
+float gamut_margin(const float rgb[3])
+{
+	float m = fminf(fminf(fminf(rgb[0], 1 - rgb[0]), fminf(rgb[1], 1 - rgb[1])), fminf(rgb[2], 1 - rgb[2]));
+	return fminf(255, fmaxf(0, 127.5f + m*1000));
+}
+
+// The small tables the OK conversions need; init_gamut_lut() also builds these.
+void init_ok_tables(void)
+{
+	for (int i = 0; i < 256; i++) {
+		srgb_linear[i] = srgb_decode(i / 255.f);
+		hue_cos[i] = cosf(i * 2*PI / 256);
+		hue_sin[i] = sinf(i * 2*PI / 256);
+	}
+	for (int i = 0; i <= 4096; i++) {
+		srgb_encode_lut[i] = srgb_encode(i / 4096.f);
+	}
+}
+
+void init_gamut_lut(void)
+{
+	double t0 = now_seconds();
+	init_ok_tables();
+	for (int li = 0; li < GAMUT_N; li++) {
+		for (int bi = 0; bi < GAMUT_N; bi++) {
+			for (int ai = 0; ai < GAMUT_N; ai++) {
+				float lab[3] = {
+					(float) li / (GAMUT_N - 1),
+					((float) ai / (GAMUT_N - 1) - 0.5f) * 2*OK_AB_MAX,
+					((float) bi / (GAMUT_N - 1) - 0.5f) * 2*OK_AB_MAX,
+				};
+				float rgb[3];
+				oklab_to_linear(lab, rgb);
+				float *g = gamut_grid[(li*GAMUT_N + bi)*GAMUT_N + ai];
+				g[0] = srgb_encode(rgb[0])*255;
+				g[1] = srgb_encode(rgb[1])*255;
+				g[2] = srgb_encode(rgb[2])*255;
+				g[3] = gamut_margin(rgb);
+				int x = (li % 8)*GAMUT_N + ai, y = (li / 8)*GAMUT_N + bi;
+				gamut_atlas[y*GAMUT_ATLAS_W + x] = (Color) { g[0] + 0.5f, g[1] + 0.5f, g[2] + 0.5f, g[3] };
+			}
+		}
+	}
+	TraceLog(LOG_INFO, "CPICK: gamut LUT built in %.1f ms", (now_seconds() - t0)*1000);
+}
+
+// What a slice shows at lab: the clipped color, washed out towards gray where it
+// is out of gamut. Points on the gamut surface interpolate to a margin of about
+// zero, hence the threshold a little below 127.5.
+#define GAMUT_EDGE 120
+// fminf/fmaxf are library calls unless NaNs are ruled out; this is the hot loop.
+static inline float clampf(float x, float lo, float hi)
+{
+	return x < lo ? lo : x > hi ? hi : x;
+}
+
+static inline Color gamut_lookup(const float lab[3])
+{
+	float gl = clampf(lab[0], 0, 1) * (GAMUT_N - 1);
+	float ga = clampf(lab[1] / (2*OK_AB_MAX) + 0.5f, 0, 1) * (GAMUT_N - 1);
+	float gb = clampf(lab[2] / (2*OK_AB_MAX) + 0.5f, 0, 1) * (GAMUT_N - 1);
+	// the last cell is interpolated with a weight of 1 rather than read past the edge
+	int l0 = MIN(gl, GAMUT_N - 2), a0 = MIN(ga, GAMUT_N - 2), b0 = MIN(gb, GAMUT_N - 2);
+	float fl = gl - l0, fa = ga - a0, fb = gb - b0;
+	const float (*p)[4] = gamut_grid + (l0*GAMUT_N + b0)*GAMUT_N + a0;
+	const int db = GAMUT_N, dl = GAMUT_N*GAMUT_N;
+	float out[4];
+	for (int k = 0; k < 4; k++) {
+		float c00 = p[0][k] + fa*(p[1][k] - p[0][k]);
+		float c01 = p[db][k] + fa*(p[db + 1][k] - p[db][k]);
+		float c10 = p[dl][k] + fa*(p[dl + 1][k] - p[dl][k]);
+		float c11 = p[dl + db][k] + fa*(p[dl + db + 1][k] - p[dl + db][k]);
+		float c0 = c00 + fb*(c01 - c00);
+		float c1 = c10 + fb*(c11 - c10);
+		out[k] = c0 + fl*(c1 - c0);
+	}
+	if (out[3] < GAMUT_EDGE) {
+		for (int k = 0; k < 3; k++) {
+			out[k] = out[k]*0.25f + 128*0.75f;
+		}
+	}
+	return (Color) { out[0] + 0.5f, out[1] + 0.5f, out[2] + 0.5f, 255 };
+}
+
+static inline Color oklab_to_display(Color c)
+{
+	float lab[3];
+	ok_to_lab(SPACE_OKLAB, c, lab);
+	return gamut_lookup(lab);
+}
+
+static inline Color oklch_to_display(Color c)
+{
+	float lab[3];
+	ok_to_lab(SPACE_OKLCH, c, lab);
+	return gamut_lookup(lab);
+}
+
+// For the OK spaces, the nearest in-gamut color.
+Color space_to_rgb(int space, Color c)
+{
+	switch (space) {
+		case SPACE_HSV:
+			return hsv_to_rgb(c);
+		case SPACE_HSL:
+			return hsl_to_rgb(c);
+		case SPACE_OKLAB:
+		case SPACE_OKLCH:
+			return ok_to_rgb(space, c);
+		default:
+			return c;
+	}
+}
+
+// Inverse of space_to_rgb, up to rounding.
+Color rgb_to_space(int space, Color rgb)
+{
+	if (space == SPACE_RGB) {
+		return rgb;
+	}
+	if (space == SPACE_OKLAB || space == SPACE_OKLCH) {
+		float lab[3];
+		rgb_to_oklab(rgb, lab);
+		unsigned char l = fminf(1, fmaxf(0, lab[0]))*255 + 0.5f;
+		if (space == SPACE_OKLAB) {
+			return (Color) { l, fminf(1, fmaxf(0, lab[1] / (2*OK_AB_MAX) + 0.5f))*255 + 0.5f,
+							 fminf(1, fmaxf(0, lab[2] / (2*OK_AB_MAX) + 0.5f))*255 + 0.5f, 255 };
+		}
+		float turns = atan2f(lab[2], lab[1]) / (2*PI);
+		return (Color) { l, fminf(1, hypotf(lab[1], lab[2]) / OK_C_MAX)*255 + 0.5f,
+						 (int) roundf((turns + 1)*256) % 256, 255 };
+	}
+	float f[3] = { rgb.r / 255.f, rgb.g / 255.f, rgb.b / 255.f }, hsx[3];
+	rgb_to_hsx(space == SPACE_HSL, f, hsx);
+	return (Color) { (int) roundf(hsx[0]*256) % 256, roundf(hsx[1]*255), roundf(hsx[2]*255), 255 };
+}
+
+Color current_color(struct state *st) 
+{
+	return space_to_rgb(st->space, slice_color(st->which_fixed, st->fixed_value, st->x_value, st->y_value));
+}
+
+int slice_axis(struct state *st)
+{
+	return 3*st->space + st->which_fixed;
+}
+
+// Pick rgb in the current space and slice axis: the inverse of current_color.
+void set_color(struct state *st, Color rgb)
+{
+	Color c = rgb_to_space(st->space, rgb);
+	unsigned char v[3] = { c.r, c.g, c.b };
+	st->fixed_value = v[CHANNEL_FIXED(st->which_fixed)];
+	st->x_value = v[CHANNEL_X(st->which_fixed)];
+	st->y_value = v[CHANNEL_Y(st->which_fixed)];
+}
+
+// Switch color space, keeping the current color (as near as 256 steps allow).
+void set_space(struct state *st, int space)
+{
+	Color rgb = current_color(st);
+	st->space = space;
+	set_color(st, rgb);
+}
+
+void draw_gradient_n(int x, int y, int n, int which_fixed, int fixed_val)  
+{
+	int cur_x = x;
+	int cur_y = y;
+	for (int v2 = 0; v2 < 256; v2++) {
+		for (int v1 = 0; v1 < 256; v1++) {
+			Color col = slice_color(which_fixed, fixed_val, v1, v2);
+			for (int iy = 0; iy < n; iy++) {
+				for (int ix = 0; ix < n; ix++) {
+					hud_draw_pixel(cur_x + ix, cur_y + iy, col);  
+				}
+			}
+			cur_x += n;
+		}
+		cur_x = x;
+		cur_y += n;
+	}
+}
+
+// One copy of the scalar fill per fixed channel, so the inner loop is a straight
+// store; fill_slice_generic picks the copy once per call.
+#define FILL_SLICE_GENERIC_WF(wf) \
+	static void fill_slice_generic_##wf(Color *pixels, int fixed_val, int y0, int y1) \
+	{ \
+		for (int v2 = y0; v2 < y1; v2++) { \
+			for (int v1 = 0; v1 < 256; v1++) { \
+				pixels[v2*256 + v1] = slice_color(wf, fixed_val, v1, v2); \
+			} \
+		} \
+	}
+FILL_SLICE_GENERIC_WF(0)
+FILL_SLICE_GENERIC_WF(1)
+FILL_SLICE_GENERIC_WF(2)
+
+void fill_slice_generic(Color *pixels, int which_fixed, int fixed_val, int y0, int y1)
+{
+	static void (*const by_axis[3])(Color *, int, int, int) = {
+		fill_slice_generic_0, fill_slice_generic_1, fill_slice_generic_2
+	};
+	by_axis[which_fixed](pixels, fixed_val, y0, y1);
+}
+
+// Scalar fills for the other spaces: the channel layout as for RGB, then one
+// conversion per pixel through hue_lut. Specialized per fixed component like
+// fill_slice_generic.
+#define FILL_SLICE_SPACE_WF(name, to_rgb, wf) \
+	static void name##_##wf(Color *pixels, int fixed_val, int y0, int y1) \
+	{ \
+		for (int v2 = y0; v2 < y1; v2++) { \
+			for (int v1 = 0; v1 < 256; v1++) { \
+				pixels[v2*256 + v1] = to_rgb(slice_color(wf, fixed_val, v1, v2)); \
+			} \
+		} \
+	}
+#define FILL_SLICE_SPACE(name, to_rgb) \
+	FILL_SLICE_SPACE_WF(name, to_rgb, 0) \
+	FILL_SLICE_SPACE_WF(name, to_rgb, 1) \
+	FILL_SLICE_SPACE_WF(name, to_rgb, 2) \
+	void name(Color *pixels, int which_fixed, int fixed_val, int y0, int y1) \
+	{ \
+		static void (*const by_axis[3])(Color *, int, int, int) = { name##_0, name##_1, name##_2 }; \
+		by_axis[which_fixed](pixels, fixed_val, y0, y1); \
+	}
+FILL_SLICE_SPACE(fill_slice_hsv, hsv_to_rgb)
+FILL_SLICE_SPACE(fill_slice_hsl, hsl_to_rgb)
+FILL_SLICE_SPACE(fill_slice_oklab, oklab_to_display)
+FILL_SLICE_SPACE(fill_slice_oklch, oklch_to_display)
+
+/*
+ * Vectorized slice fill. Read as a little-endian uint32, an RGBA8 pixel is
+ * r | g<<8 | b<<16 | a<<24. Within a slice the fixed channel sits at 8*which_fixed,
+ * x at the next channel and y at the one after that (see slice_color), so
+ * every row is a constant (fixed, y and alpha) OR'd with a ramp of x values.
+ */
+#define SLICE_SHIFTS(wf) \
+	int fixed_shift = 8*CHANNEL_FIXED(wf); \
+	int x_shift = 8*CHANNEL_X(wf); \
+	int y_shift = 8*CHANNEL_Y(wf);
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+void fill_slice_sse2(Color *pixels, int which_fixed, int fixed_val, int y0, int y1)
+{
+	SLICE_SHIFTS(which_fixed);
+	uint32_t *out = (uint32_t *) pixels + y0*256;
+	__m128i ramp = _mm_sll_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_cvtsi32_si128(x_shift));
+	__m128i step = _mm_set1_epi32(4u << x_shift);
+	for (uint32_t y = y0; y < (uint32_t) y1; y++) {
+		__m128i row = _mm_set1_epi32(0xff000000u | (uint32_t) fixed_val << fixed_shift | y << y_shift);
+		__m128i xv = ramp;
+		for (int x = 0; x < 256; x += 4) {
+			_mm_storeu_si128((__m128i *) (out + x), _mm_or_si128(row, xv));
+			xv = _mm_add_epi32(xv, step);
+		}
+		out += 256;
+	}
+}
+
+__attribute__((target("avx2")))
+void fill_slice_avx2(Color *pixels, int which_fixed, int fixed_val, int y0, int y1)
+{
+	SLICE_SHIFTS(which_fixed);
+	uint32_t *out = (uint32_t *) pixels + y0*256;
+	__m256i ramp = _mm256_sll_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm_cvtsi32_si128(x_shift));
+	__m256i step = _mm256_set1_epi32(8u << x_shift);
+	for (uint32_t y = y0; y < (uint32_t) y1; y++) {
+		__m256i row = _mm256_set1_epi32(0xff000000u | (uint32_t) fixed_val << fixed_shift | y << y_shift);
+		__m256i xv = ramp;
+		for (int x = 0; x < 256; x += 8) {
+			_mm256_storeu_si256((__m256i *) (out + x), _mm256_or_si256(row, xv));
+			xv = _mm256_add_epi32(xv, step);
+		}
+		out += 256;
+	}
+}
+#endif
+
+#if defined(__ARM_NEON)
+void fill_slice_neon(Color *pixels, int which_fixed, int fixed_val, int y0, int y1)
+{
+	SLICE_SHIFTS(which_fixed);
+	uint32_t *out = (uint32_t *) pixels + y0*256;
+	const uint32_t ramp_init[4] = { 0, 1, 2, 3 };
+	uint32x4_t ramp = vshlq_u32(vld1q_u32(ramp_init), vdupq_n_s32(x_shift));
+	uint32x4_t step = vdupq_n_u32(4u << x_shift);
+	for (uint32_t y = y0; y < (uint32_t) y1; y++) {
+		uint32x4_t row = vdupq_n_u32(0xff000000u | (uint32_t) fixed_val << fixed_shift | y << y_shift);
+		uint32x4_t xv = ramp;
+		for (int x = 0; x < 256; x += 4) {
+			vst1q_u32(out + x, vorrq_u32(row, xv));
+			xv = vaddq_u32(xv, step);
+		}
+		out += 256;
+	}
+}
+#endif
+
+// Best kernel for this machine, picked by init_fill_slice(). Fills rows [y0, y1).
+void (*fill_slice)(Color *pixels, int which_fixed, int fixed_val, int y0, int y1) = fill_slice_generic;
+// Fewest rows worth handing to another thread. The vector kernels fill a whole
+// slice faster than a thread wakes up, so they run inline.
+int fill_slice_grain = 64;
+
+void init_fill_slice(void)
+{
+	const char *name = "generic";
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		fill_slice = fill_slice_avx2;
+		fill_slice_grain = 256;
+		name = "avx2";
+	} else if (__builtin_cpu_supports("sse2")) {
+		fill_slice = fill_slice_sse2;
+		fill_slice_grain = 256;
+		name = "sse2";
+	}
+#elif defined(__ARM_NEON)
+	fill_slice = fill_slice_neon;
+	fill_slice_grain = 256;
+	name = "neon";
+#endif
+	TraceLog(LOG_INFO, "CPICK: slice fill kernel: %s", name);
+	init_hue_lut();
+	init_gamut_lut();
+}
+
+// Fill rows [y0, y1) of the slice for axis (3*space + which_fixed, see slice_axis).
+void fill_slice_axis(Color *pixels, int axis, int fixed_val, int y0, int y1)
+{
+	switch (axis / 3) {
+		case SPACE_HSV:
+			fill_slice_hsv(pixels, axis % 3, fixed_val, y0, y1);
+			break;
+		case SPACE_HSL:
+			fill_slice_hsl(pixels, axis % 3, fixed_val, y0, y1);
+			break;
+		case SPACE_OKLAB:
+			fill_slice_oklab(pixels, axis % 3, fixed_val, y0, y1);
+			break;
+		case SPACE_OKLCH:
+			fill_slice_oklch(pixels, axis % 3, fixed_val, y0, y1);
+			break;
+		default:
+			fill_slice(pixels, axis % 3, fixed_val, y0, y1);
+	}
+}
+
+/*
+ * Fork-join pool for splitting slice generation into row bands. parallel_for()
+ * runs fn over [0, n) in bands of at least grain rows, on the pool's threads plus
+ * the calling thread, and returns once every band is done, so the caller can
+ * upload the result right away.
+ */
+struct thread_pool {
+	int nthreads;
+	pthread_t *threads;
+	pthread_mutex_t job_lock; // one parallel_for at a time
+	pthread_mutex_t lock; // everything below
+	pthread_cond_t start;
+	pthread_cond_t finished;
+	void (*fn)(void *ctx, int begin, int end);
+	void *ctx;
+	int n;
+	int band;
+	int next; // first row not handed out yet
+	int busy; // bands being worked on
+	unsigned long job;
+	bool quit;
+};
+
+struct thread_pool workers;
+
+// Called with tp->lock held: take bands of the current job until none are left.
+void run_bands(struct thread_pool *tp)
+{
+	while (tp->next < tp->n) {
+		int begin = tp->next;
+		int end = MIN(tp->n, begin + tp->band);
+		tp->next = end;
+		tp->busy++;
+		pthread_mutex_unlock(&tp->lock);
+		tp->fn(tp->ctx, begin, end);
+		pthread_mutex_lock(&tp->lock);
+		tp->busy--;
+	}
+	if (tp->busy == 0) {
+		pthread_cond_broadcast(&tp->finished);
+	}
+}
+
+void *pool_thread(void *arg)
+{
+	struct thread_pool *tp = arg;
+	unsigned long seen = 0;
+	pthread_mutex_lock(&tp->lock);
+	for (;;) {
+		while (!tp->quit && tp->job == seen) {
+			pthread_cond_wait(&tp->start, &tp->lock);
+		}
+		if (tp->quit) {
+			break;
+		}
+		seen = tp->job;
+		run_bands(tp);
+	}
+	pthread_mutex_unlock(&tp->lock);
+	return NULL;
+}
+
+// nthreads <= 0: one per core, not counting the caller's
+void thread_pool_init(struct thread_pool *tp, int nthreads)
+{
+	if (nthreads <= 0) {
+		nthreads = MAX(0, sysconf(_SC_NPROCESSORS_ONLN) - 1);
+	}
+	tp->nthreads = nthreads;
+	tp->threads = (pthread_t *) malloc(nthreads*sizeof(pthread_t));
+	pthread_mutex_init(&tp->job_lock, NULL);
+	pthread_mutex_init(&tp->lock, NULL);
+	pthread_cond_init(&tp->start, NULL);
+	pthread_cond_init(&tp->finished, NULL);
+	tp->n = tp->next = tp->busy = 0;
+	tp->job = 0;
+	tp->quit = false;
+	for (int i = 0; i < nthreads; i++) {
+		pthread_create(&tp->threads[i], NULL, pool_thread, tp);
+	}
+}
+
+void thread_pool_free(struct thread_pool *tp)
+{
+	pthread_mutex_lock(&tp->lock);
+	tp->quit = true;
+	pthread_cond_broadcast(&tp->start);
+	pthread_mutex_unlock(&tp->lock);
+	for (int i = 0; i < tp->nthreads; i++) {
+		pthread_join(tp->threads[i], NULL);
+	}
+	free(tp->threads);
+	pthread_mutex_destroy(&tp->job_lock);
+	pthread_mutex_destroy(&tp->lock);
+	pthread_cond_destroy(&tp->start);
+	pthread_cond_destroy(&tp->finished);
+}
+
+void parallel_for(struct thread_pool *tp, int n, int grain, void (*fn)(void *ctx, int begin, int end), void *ctx)
+{
+	if (tp->nthreads == 0 || n <= grain) {
+		fn(ctx, 0, n);
+		return;
+	}
+	pthread_mutex_lock(&tp->job_lock);
+	pthread_mutex_lock(&tp->lock);
+	tp->fn = fn;
+	tp->ctx = ctx;
+	tp->n = n;
+	// a few bands per thread evens out threads that start late
+	int bands = 4*(tp->nthreads + 1);
+	tp->band = MAX(grain, (n + bands - 1) / bands);
+	tp->next = 0;
+	tp->job++;
+	pthread_cond_broadcast(&tp->start);
+	run_bands(tp);
+	while (tp->next < tp->n || tp->busy > 0) {
+		pthread_cond_wait(&tp->finished, &tp->lock);
+	}
+	pthread_mutex_unlock(&tp->lock);
+	pthread_mutex_unlock(&tp->job_lock);
+}
+
+struct fill_job {
+	Color *pixels;
+	int axis;
+	int fixed_val;
+};
+
+void fill_band(void *ctx, int y0, int y1)
+{
+	struct fill_job *job = ctx;
+	fill_slice_axis(job->pixels, job->axis, job->fixed_val, y0, y1);
+}
+
+// fill_slice_axis over the whole slice, split across workers in bands of fill_slice_grain
+// rows.
+void fill_slice_parallel(Color *pixels, int axis, int fixed_val)
+{
+	struct fill_job job = { pixels, axis, fixed_val };
+	// only RGB has vector kernels; the conversions are worth splitting up
+	parallel_for(&workers, 256, axis < 3 ? fill_slice_grain : 32, fill_band, &job);
+}
+
+void *prefetch_worker(void *arg)
+{
+	struct slice_pool *pool = arg;
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->quit) {
+		struct prefetch_job *job = NULL;
+		for (int i = 0; i < PREFETCH_JOBS; i++) {
+			if (pool->jobs[i].state == JOB_QUEUED) {
+				job = &pool->jobs[i];
+				break;
+			}
+		}
+		if (!job) {
+			pthread_cond_wait(&pool->wake, &pool->lock);
+			continue;
+		}
+		job->state = JOB_FILLING;
+		pthread_mutex_unlock(&pool->lock);
+		fill_slice_axis(job->pixels, job->axis, job->fixed_value, 0, 256);
+		pthread_mutex_lock(&pool->lock);
+		job->state = JOB_DONE;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+void slice_pool_init(struct slice_pool *pool)
+{
+	Image img = GenImageColor(256, 256, BLACK);
+	for (int i = 0; i < SLICE_POOL_SIZE; i++) {
+		pool->entries[i].tex = LoadTextureFromImage(img);
+		SetTextureFilter(pool->entries[i].tex, TEXTURE_FILTER_POINT);
+		pool->entries[i].axis = -1;
+		pool->entries[i].last_used = 0;
+	}
+	UnloadImage(img);
+	pool->clock = 0;
+	pool->filter = TEXTURE_FILTER_POINT;
+	pool->pixels = (Color *) malloc(256*256*sizeof(Color));
+	for (int i = 0; i < PREFETCH_JOBS; i++) {
+		pool->jobs[i].state = JOB_FREE;
+		pool->jobs[i].pixels = (Color *) malloc(256*256*sizeof(Color));
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pool->quit = false;
+	pthread_create(&pool->worker, NULL, prefetch_worker, pool);
+}
+
+void slice_pool_free(struct slice_pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_signal(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	pthread_join(pool->worker, NULL);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->wake);
+	for (int i = 0; i < PREFETCH_JOBS; i++) {
+		free(pool->jobs[i].pixels);
+	}
+	for (int i = 0; i < SLICE_POOL_SIZE; i++) {
+		UnloadTexture(pool->entries[i].tex);
+	}
+	free(pool->pixels);
+}
+
+// Forget every cached slice (the textures stay allocated).
+void slice_pool_invalidate(struct slice_pool *pool)
+{
+	for (int i = 0; i < SLICE_POOL_SIZE; i++) {
+		pool->entries[i].axis = -1;
+	}
+}
+
+struct slice_entry *slice_pool_find(struct slice_pool *pool, int axis, int fixed_value)
+{
+	for (int i = 0; i < SLICE_POOL_SIZE; i++) {
+		struct slice_entry *e = &pool->entries[i];
+		if (e->axis == axis && e->fixed_value == fixed_value) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+struct slice_entry *slice_pool_victim(struct slice_pool *pool)
+{
+	struct slice_entry *victim = &pool->entries[0];
+	for (int i = 1; i < SLICE_POOL_SIZE; i++) {
+		if (pool->entries[i].last_used < victim->last_used) {
+			victim = &pool->entries[i];
+		}
+	}
+	return victim;
+}
+
+void slice_pool_store(struct slice_pool *pool, int axis, int fixed_value, Color *pixels)
+{
+	struct slice_entry *e = slice_pool_victim(pool);
+	UpdateTexture(e->tex, pixels);
+	e->axis = axis;
+	e->fixed_value = fixed_value;
+	e->last_used = ++pool->clock;
+}
+
+// The texture for a slice, filling and uploading it right away on a miss.
+Texture2D slice_pool_get(struct slice_pool *pool, int axis, int fixed_value)
+{
+	struct slice_entry *e = slice_pool_find(pool, axis, fixed_value);
+	if (e) {
+		e->last_used = ++pool->clock;
+		return e->tex;
+	}
+	fill_slice_parallel(pool->pixels, axis, fixed_value);
+	slice_pool_store(pool, axis, fixed_value, pool->pixels);
+	return slice_pool_find(pool, axis, fixed_value)->tex;
+}
+
+// Queue the slices around fixed_value, mostly in direction dir (+1/-1), that aren't
+// cached or already on their way.
+void slice_pool_prefetch(struct slice_pool *pool, int axis, int fixed_value, int dir)
+{
+	pthread_mutex_lock(&pool->lock);
+	for (int step = -1; step <= PREFETCH_AHEAD; step++) {
+		int v = fixed_value + dir*step;
+		if (step == 0 || v < 0 || v > 255 || slice_pool_find(pool, axis, v)) {
+			continue;
+		}
+		struct prefetch_job *free_job = NULL;
+		bool pending = false;
+		for (int i = 0; i < PREFETCH_JOBS; i++) {
+			struct prefetch_job *job = &pool->jobs[i];
+			if (job->state == JOB_FREE) {
+				free_job = free_job ? free_job : job;
+			} else if (job->axis == axis && job->fixed_value == v) {
+				pending = true;
+			}
+		}
+		if (!pending && free_job) {
+			free_job->axis = axis;
+			free_job->fixed_value = v;
+			free_job->state = JOB_QUEUED;
+			pthread_cond_signal(&pool->wake);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// Upload up to max finished prefetches into the pool.
+void slice_pool_upload_ready(struct slice_pool *pool, int max)
+{
+	pthread_mutex_lock(&pool->lock);
+	for (int i = 0; i < PREFETCH_JOBS && max > 0; i++) {
+		struct prefetch_job *job = &pool->jobs[i];
+		if (job->state != JOB_DONE) {
+			continue;
+		}
+		if (!slice_pool_find(pool, job->axis, job->fixed_value)) {
+			slice_pool_store(pool, job->axis, job->fixed_value, job->pixels);
+			max--;
+		}
+		job->state = JOB_FREE;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// Nearest sampling keeps the 256 steps crisp when magnified; below 256px bilinear
+// filtering avoids aliasing.
+void slice_pool_set_filter(struct slice_pool *pool, int filter)
+{
+	if (filter == pool->filter) {
+		return;
+	}
+	for (int i = 0; i < SLICE_POOL_SIZE; i++) {
+		SetTextureFilter(pool->entries[i].tex, filter);
+	}
+	pool->filter = filter;
+}
+
+// Same picture as draw_gradient_n, but drawn from the slice pool as a single textured
+// quad of any size; the slice is only generated if it isn't cached yet.
+void draw_gradient_cached(int x, int y, int size, struct state *st)
+{
+	struct slice_pool *pool = st->slices;
+	if (st->fixed_value != st->prefetch_last_value) {
+		st->prefetch_dir = st->fixed_value > st->prefetch_last_value ? 1 : -1;
+		st->prefetch_last_value = st->fixed_value;
+	}
+	if (st->val_slider_dragging) {
+		slice_pool_prefetch(pool, slice_axis(st), st->fixed_value, st->prefetch_dir);
+	}
+	slice_pool_upload_ready(pool, PREFETCH_UPLOADS);
+	Texture2D tex = slice_pool_get(pool, slice_axis(st), st->fixed_value);
+	slice_pool_set_filter(pool, size >= 256 ? TEXTURE_FILTER_POINT : TEXTURE_FILTER_BILINEAR);
+	hud_draw_texture_pro(tex, (Rectangle) { 0, 0, 256, 256 }, (Rectangle) { x, y, size, size },
+						 (Vector2) { 0, 0 }, 0., WHITE);
+}
+
+// Which components are hues, stepped around the circle (k/steps turns) rather
+// than across 0-1 (k/(steps - 1)).
+static inline bool channel_is_hue(int space, int i)
+{
+	return (i == 0 && (space == SPACE_HSV || space == SPACE_HSL)) || (i == 2 && space == SPACE_OKLCH);
+}
+
+static inline float deep_value(int space, int i, int k, int steps)
+{
+	return channel_is_hue(space, i) ? (float) k / steps : (float) k / (steps - 1);
+}
+
+// The 8-bit fields follow the deep steps rounded, so the rest of cpick (history,
+// name lookup, background) works unchanged. deep_pull() picks up changes made
+// through the 8-bit fields since the last sync; a change that keeps the 8-bit
+// components (such as swapping the fixed axis) keeps the full precision.
+void deep_pull(struct state *st)
+{
+	Color b = slice_color(st->which_fixed, st->fixed_value, st->x_value, st->y_value);
+	b.a = st->space; // the same bytes in another space are another color
+	if (b.r == st->deep_key.r && b.g == st->deep_key.g && b.b == st->deep_key.b && b.a == st->deep_key.a) {
+		return;
+	}
+	unsigned char v[3] = { b.r, b.g, b.b };
+	int steps = st->deep_steps;
+	for (int i = 0; i < 3; i++) {
+		st->deep[i] = channel_is_hue(st->space, i) ? v[i]*steps / 256 : (v[i]*(steps - 1) + 127) / 255;
+	}
+	st->deep_key = b;
+}
+
+void deep_push(struct state *st)
+{
+	unsigned char v[3];
+	int steps = st->deep_steps;
+	for (int i = 0; i < 3; i++) {
+		v[i] = channel_is_hue(st->space, i) ? st->deep[i]*256 / steps
+			: (st->deep[i]*255 + (steps - 1)/2) / (steps - 1);
+	}
+	st->fixed_value = v[CHANNEL_FIXED(st->which_fixed)];
+	st->x_value = v[CHANNEL_X(st->which_fixed)];
+	st->y_value = v[CHANNEL_Y(st->which_fixed)];
+	st->deep_key = (Color) { v[0], v[1], v[2], st->space };
+}
+
+/*
+ * Components (0-1, hue in turns) to sRGB (0-1) in float. Out of gamut OK colors
+ * are clipped, and for display (wash) also washed out the way gamut_lookup()
+ * does.
+ */
+void components_to_rgb(int space, const float c[3], float rgb[3], bool wash)
+{
+	if (space == SPACE_RGB) {
+		memcpy(rgb, c, 3*sizeof(float));
+	} else if (space == SPACE_HSV || space == SPACE_HSL) {
+		hsx_to_rgb(space == SPACE_HSL, c, rgb);
+	} else {
+		float lab[3] = { c[0], (c[1] - 0.5f)*2*OK_AB_MAX, (c[2] - 0.5f)*2*OK_AB_MAX };
+		if (space == SPACE_OKLCH) {
+			lab[1] = c[1]*OK_C_MAX*cosf(c[2]*2*PI);
+			lab[2] = c[1]*OK_C_MAX*sinf(c[2]*2*PI);
+		}
+		float lin[3];
+		oklab_to_linear(lab, lin);
+		bool out = !in_gamut(lin);
+		for (int k = 0; k < 3; k++) {
+			rgb[k] = srgb_encode(clampf(lin[k], 0, 1));
+			if (out && wash) {
+				rgb[k] += (128/255.f - rgb[k])*0.75f;
+			}
+		}
+	}
+}
+
+// The picked color at full precision.
+void deep_color(struct state *st, float rgb[3])
+{
+	float c[3];
+	for (int i = 0; i < 3; i++) {
+		c[i] = deep_value(st->space, i, st->deep[i], st->deep_steps);
+	}
+	components_to_rgb(st->space, c, rgb, false);
+}
+
+// For 0 <= f, as tiles hold; rounds to nearest (ties up), and keeps subnormals, which below
+// 6e-5 is where the first few 16-bit steps are.
+static inline uint16_t float_to_half(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, 4);
+	int e = (int) ((x >> 23) & 0xff) - 127 + 15;
+	uint32_t m = (x & 0x7fffff) | 0x800000;
+	if (e >= 31) {
+		return 0x7c00;
+	}
+	if (e <= 0) {
+		if (e < -10) {
+			return 0;
+		}
+		int shift = 14 - e;
+		return (m >> shift) + ((m >> (shift - 1)) & 1);
+	}
+	return ((e << 10) | ((m >> 13) & 0x3ff)) + ((m >> 12) & 1);
+}
+
+void pack_half_generic(const float *in, uint16_t *out, int n)
+{
+	for (int i = 0; i < n; i++) {
+		out[i] = float_to_half(in[i]);
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx,f16c")))
+void pack_half_f16c(const float *in, uint16_t *out, int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm_storeu_si128((__m128i *) (out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+	}
+	pack_half_generic(in + i, out + i, n - i);
+}
+#endif
+
+// float to half for a run of tile texels; the texture upload wants them packed
+void (*pack_half)(const float *in, uint16_t *out, int n) = pack_half_generic;
+
+void deep_tiles_init(struct deep_tiles *dt, int bits)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("f16c")) {
+		pack_half = pack_half_f16c;
+	}
+#endif
+	dt->format = bits <= 10 ? PIXELFORMAT_UNCOMPRESSED_R16G16B16A16 : PIXELFORMAT_UNCOMPRESSED_R32G32B32A32;
+	size_t texel = dt->format == PIXELFORMAT_UNCOMPRESSED_R16G16B16A16 ? 4*sizeof(uint16_t) : 4*sizeof(float);
+	dt->pixels = calloc(DEEP_TILE*DEEP_TILE, texel);
+	Image img = { dt->pixels, DEEP_TILE, DEEP_TILE, 1, dt->format };
+	for (int i = 0; i < DEEP_TILES; i++) {
+		dt->tiles[i].tex = LoadTextureFromImage(img);
+		dt->tiles[i].axis = -1;
+		SetTextureFilter(dt->tiles[i].tex, TEXTURE_FILTER_POINT);
+	}
+}
+
+void deep_tiles_free(struct deep_tiles *dt)
+{
+	if (!dt->pixels) {
+		return;
+	}
+	for (int i = 0; i < DEEP_TILES; i++) {
+		UnloadTexture(dt->tiles[i].tex);
+	}
+	free(dt->pixels);
+	dt->pixels = NULL;
+}
+
+struct deep_fill_job {
+	struct deep_tiles *dt;
+	int space;
+	int wf;
+	int fixed;
+	int steps;
+	int shift; // tile texel to step
+	int x0; // first texel of the tile across the whole level
+	int y0;
+};
+
+// One component at one position of the tile, with what its hue costs precomputed
+// once per row or column instead of per texel: the saturated color for HSV/HSL,
+// cos and sin for OKLCH.
+struct deep_axis {
+	float v;
+	float aux[3];
+};
+
+void deep_axis_set(struct deep_axis *a, int space, int i, int k, int steps)
+{
+	a->v = deep_value(space, i, k, steps);
+	if (!channel_is_hue(space, i)) {
+		return;
+	}
+	if (space == SPACE_OKLCH) {
+		a->aux[0] = cosf(a->v*2*PI);
+		a->aux[1] = sinf(a->v*2*PI);
+	} else {
+		hue_ramp(a->v, a->aux);
+	}
+}
+
+static inline float srgb_encode_fast(float x)
+{
+	float f = clampf(x, 0, 1)*4096;
+	int i = MIN(4095, (int) f);
+	return srgb_encode_lut[i] + (srgb_encode_lut[i + 1] - srgb_encode_lut[i])*(f - i);
+}
+
+// components_to_rgb(space, c, rgb, true) from deep_axis components
+static inline void deep_display(int space, const struct deep_axis *c[3], float rgb[3])
+{
+	switch (space) {
+		case SPACE_RGB:
+			rgb[0] = c[0]->v;
+			rgb[1] = c[1]->v;
+			rgb[2] = c[2]->v;
+			return;
+		case SPACE_HSV:
+			for (int k = 0; k < 3; k++) {
+				rgb[k] = c[2]->v*(1 - c[1]->v*(1 - c[0]->aux[k]));
+			}
+			return;
+		case SPACE_HSL: {
+			float chroma = (1 - fabsf(2*c[2]->v - 1))*c[1]->v;
+			for (int k = 0; k < 3; k++) {
+				rgb[k] = c[2]->v + chroma*(c[0]->aux[k] - 0.5f);
+			}
+			return;
+		}
+	}
+	float lab[3] = { c[0]->v, (c[1]->v - 0.5f)*2*OK_AB_MAX, (c[2]->v - 0.5f)*2*OK_AB_MAX };
+	if (space == SPACE_OKLCH) {
+		lab[1] = c[1]->v*OK_C_MAX*c[2]->aux[0];
+		lab[2] = c[1]->v*OK_C_MAX*c[2]->aux[1];
+	}
+	float lin[3];
+	oklab_to_linear(lab, lin);
+	bool out = !in_gamut(lin);
+	for (int k = 0; k < 3; k++) {
+		rgb[k] = srgb_encode_fast(lin[k]);
+		if (out) {
+			rgb[k] += (128/255.f - rgb[k])*0.75f;
+		}
+	}
+}
+
+void deep_fill_band(void *ctx, int y0, int y1)
+{
+	struct deep_fill_job *job = ctx;
+	bool half = job->dt->format == PIXELFORMAT_UNCOMPRESSED_R16G16B16A16;
+	int space = job->space, wf = job->wf;
+	struct deep_axis fixed, row, cols[DEEP_TILE];
+	deep_axis_set(&fixed, space, CHANNEL_FIXED(wf), job->fixed, job->steps);
+	for (int i = 0; i < DEEP_TILE; i++) {
+		deep_axis_set(&cols[i], space, CHANNEL_X(wf), (job->x0 + i) << job->shift, job->steps);
+	}
+	const struct deep_axis *c[3];
+	c[CHANNEL_FIXED(wf)] = &fixed;
+	c[CHANNEL_Y(wf)] = &row;
+	float line[4*DEEP_TILE]; // a row in float, before packing to half
+	for (int r = y0; r < y1; r++) {
+		deep_axis_set(&row, space, CHANNEL_Y(wf), (job->y0 + r) << job->shift, job->steps);
+		float *p = half ? line : (float *) job->dt->pixels + 4*r*DEEP_TILE;
+		for (int i = 0; i < DEEP_TILE; i++) {
+			c[CHANNEL_X(wf)] = &cols[i];
+			deep_display(space, c, p + 4*i);
+			p[4*i + 3] = 1;
+		}
+		if (half) {
+			pack_half(line, (uint16_t *) job->dt->pixels + 4*r*DEEP_TILE, 4*DEEP_TILE);
+		}
+	}
+}
+
+// Tile (tx, ty) of level for the current slice, filled and uploaded on a miss.
+Texture2D deep_tile_get(struct state *st, int level, int tx, int ty)
+{
+	struct deep_tiles *dt = &st->tiles;
+	int axis = slice_axis(st), fixed = st->deep[CHANNEL_FIXED(st->which_fixed)];
+	struct deep_tile *victim = &dt->tiles[0];
+	dt->clock++;
+	for (int i = 0; i < DEEP_TILES; i++) {
+		struct deep_tile *t = &dt->tiles[i];
+		if (t->axis == axis && t->fixed == fixed && t->level == level && t->tx == tx && t->ty == ty) {
+			t->last_used = dt->clock;
+			return t->tex;
+		}
+		if (t->last_used < victim->last_used) {
+			victim = t;
+		}
+	}
+	struct deep_fill_job job = {
+		dt, st->space, st->which_fixed, fixed, st->deep_steps, st->deep_bits - 8 - level,
+		tx*DEEP_TILE, ty*DEEP_TILE
+	};
+	parallel_for(&workers, DEEP_TILE, 16, deep_fill_band, &job);
+	UpdateTexture(victim->tex, dt->pixels);
+	*victim = (struct deep_tile) { victim->tex, axis, fixed, level, tx, ty, dt->clock };
+	return victim->tex;
+}
+
+// The view (view_x, view_y, view_span, as fractions of the slice) drawn from the
+// tiles of the shallowest level that still has 256 texels or more across it.
+void draw_gradient_deep(int x, int y, int size, struct state *st)
+{
+	float vx = st->view_x, vy = st->view_y, span = st->view_span;
+	int level = MIN(st->deep_bits - 8, MAX(0, (int) floorf(log2f(2 / span))));
+	int n = 1 << level;
+	float tu = 1.f / n;
+	int tx0 = vx*n, ty0 = vy*n;
+	int tx1 = MIN(n - 1, (int) ((vx + span)*n - 1e-4f)), ty1 = MIN(n - 1, (int) ((vy + span)*n - 1e-4f));
+	for (int ty = ty0; ty <= ty1; ty++) {
+		for (int tx = tx0; tx <= tx1; tx++) {
+			float u0 = MAX(vx, tx*tu), u1 = MIN(vx + span, (tx + 1)*tu);
+			float v0 = MAX(vy, ty*tu), v1 = MIN(vy + span, (ty + 1)*tu);
+			Texture2D tex = deep_tile_get(st, level, tx, ty);
+			Rectangle src = { (u0 - tx*tu)*n*DEEP_TILE, (v0 - ty*tu)*n*DEEP_TILE, (u1 - u0)*n*DEEP_TILE, (v1 - v0)*n*DEEP_TILE };
+			Rectangle dst = { x + (u0 - vx)/span*size, y + (v0 - vy)/span*size, (u1 - u0)/span*size, (v1 - v0)/span*size };
+			hud_draw_texture_pro(tex, src, dst, (Vector2) { 0, 0 }, 0., WHITE);
+		}
+	}
+}
+
+// Where step k of the x or y component is in the square, in pixels from its edge.
+float deep_to_offset(struct state *st, float view_origin, int k, int size)
+{
+	return ((k + 0.5f) / st->deep_steps - view_origin) / st->view_span * size;
+}
+
+int deep_from_offset(struct state *st, float view_origin, float offset, int size)
+{
+	int k = floorf((view_origin + offset / size * st->view_span) * st->deep_steps);
+	return MIN(st->deep_steps - 1, MAX(0, k));
+}
+
+// Zoom by 2^(clicks/2) about the point offset (pixels) into the square.
+void deep_zoom(struct state *st, float clicks, Vector2 offset, int size)
+{
+	float span = st->view_span * powf(2, -clicks/2);
+	span = MIN(1, MAX((float) DEEP_MIN_VIEW / st->deep_steps, span));
+	float px = offset.x / size, py = offset.y / size;
+	st->view_x = MIN(1 - span, MAX(0, st->view_x + px*(st->view_span - span)));
+	st->view_y = MIN(1 - span, MAX(0, st->view_y + py*(st->view_span - span)));
+	st->view_span = span;
+}
+
+// Fragment shader version of fill_slice, for raylib's default vertex shader. The
+// quad's texture coordinates run 0-1 across the square; they are quantized to the
+// same 256 steps the CPU path (and current_color) uses so what you see is what you pick.
+const char *gradient_fs =
+	"#version 330\n"
+	"in vec2 fragTexCoord;\n"
+	"in vec4 fragColor;\n"
+	"out vec4 finalColor;\n"
+	"uniform int space;\n"
+	"uniform int which_fixed;\n"
+	"uniform float fixed_value;\n"
+	"uniform sampler2D gamut_lut;\n"
+	"uniform float contrast_min;\n" // 0: no overlay
+	"uniform float contrast_ref;\n" // reference relative luminance
+	"vec3 gamut(vec3 lab)\n" // gamut_lookup
+	"{\n"
+	"	vec3 g = clamp(vec3(lab.x, lab.yz/0.8 + 0.5), 0.0, 1.0)*63.0;\n"
+	"	float l0 = floor(g.x);\n"
+	"	float l1 = min(l0 + 1.0, 63.0);\n"
+	"	vec4 c0 = texture(gamut_lut, (vec2(mod(l0, 8.0), floor(l0/8.0))*64.0 + g.yz + 0.5)/512.0);\n"
+	"	vec4 c1 = texture(gamut_lut, (vec2(mod(l1, 8.0), floor(l1/8.0))*64.0 + g.yz + 0.5)/512.0);\n"
+	"	vec4 c = mix(c0, c1, g.x - l0);\n"
+	"	return c.a < 120.0/255.0 ? mix(c.rgb, vec3(128.0/255.0), 0.75) : c.rgb;\n"
+	"}\n"
+	"vec3 hue(float h)\n" // hue_lut, h in turns
+	"{\n"
+	"	vec3 k = mod(vec3(5.0, 3.0, 1.0) + h*6.0, 6.0);\n"
+	"	return 1.0 - clamp(min(k, 4.0 - k), 0.0, 1.0);\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 v = min(floor(fragTexCoord*256.0), 255.0);\n"
+	"	vec3 c;\n" // same mapping as slice_color, in 0-255 steps
+	"	c[which_fixed] = fixed_value;\n"
+	"	c[(which_fixed + 1) % 3] = v.x;\n"
+	"	c[(which_fixed + 2) % 3] = v.y;\n"
+	"	vec3 col = c / 255.0;\n"
+	"	if (space == 1) {\n" // hsv_to_rgb
+	"		col = col.z*(1.0 - col.y*(1.0 - hue(c.x/256.0)));\n"
+	"	} else if (space == 2) {\n" // hsl_to_rgb
+	"		float chroma = (1.0 - abs(2.0*col.z - 1.0))*col.y;\n"
+	"		col = col.z + chroma*(hue(c.x/256.0) - 0.5);\n"
+	"	} else if (space == 3) {\n" // oklab_to_display
+	"		col = gamut(vec3(col.x, (col.yz - 0.5)*0.8));\n"
+	"	} else if (space == 4) {\n" // oklch_to_display
+	"		float h = c.z/256.0*6.28318531;\n"
+	"		col = gamut(vec3(col.x, col.y*0.4*vec2(cos(h), sin(h))));\n"
+	"	}\n"
+	"	if (contrast_min > 0.0) {\n" // relative_luminance, contrast_ratio
+	"		vec3 lin = mix(col/12.92, pow((col + 0.055)/1.055, vec3(2.4)), step(0.04045, col));\n"
+	"		float y = dot(lin, vec3(0.2126, 0.7152, 0.0722));\n"
+	"		float ratio = (max(y, contrast_ref) + 0.05)/(min(y, contrast_ref) + 0.05);\n"
+	"		if (ratio >= contrast_min && mod(gl_FragCoord.x + gl_FragCoord.y, 8.0) < 2.0) {\n"
+	"			col = mix(col, vec3(y > 0.179 ? 0.0 : 1.0), 0.5);\n" // hatch in whichever of black/white shows
+	"		}\n"
+	"	}\n"
+	"	finalColor = vec4(col, 1.0);\n"
+	"}\n";
+
+// Returns false if the driver couldn't build the shader, in which case raylib hands
+// back its default shader, which doesn't have our uniforms.
+bool load_gradient_shader(struct state *st)
+{
+	st->gradient_shader = LoadShaderFromMemory(NULL, gradient_fs);
+	st->which_fixed_loc = GetShaderLocation(st->gradient_shader, "which_fixed");
+	st->fixed_value_loc = GetShaderLocation(st->gradient_shader, "fixed_value");
+	st->space_loc = GetShaderLocation(st->gradient_shader, "space");
+	st->gamut_lut_loc = GetShaderLocation(st->gradient_shader, "gamut_lut");
+	st->contrast_min_loc = GetShaderLocation(st->gradient_shader, "contrast_min");
+	st->contrast_ref_loc = GetShaderLocation(st->gradient_shader, "contrast_ref");
+	if (st->which_fixed_loc < 0 || st->fixed_value_loc < 0 || st->space_loc < 0 || st->gamut_lut_loc < 0) {
+		UnloadShader(st->gradient_shader);
+		return false;
+	}
+	return true;
+}
+
+// One quad, colored entirely by gradient_shader. slice_tex is only used for its
+// texture coordinates here; its contents are never filled in this mode.
+void draw_gradient_shader(int x, int y, int w, int h, struct state *st)
+{
+	float fixed_value = st->fixed_value;
+	SetShaderValue(st->gradient_shader, st->space_loc, &st->space, SHADER_UNIFORM_INT);
+	SetShaderValue(st->gradient_shader, st->which_fixed_loc, &st->which_fixed, SHADER_UNIFORM_INT);
+	SetShaderValue(st->gradient_shader, st->fixed_value_loc, &fixed_value, SHADER_UNIFORM_FLOAT);
+	float contrast_min = st->contrast_level ? contrast_levels[st->contrast_level].ratio : 0;
+	float contrast_ref = relative_luminance(st->contrast_ref);
+	SetShaderValue(st->gradient_shader, st->contrast_min_loc, &contrast_min, SHADER_UNIFORM_FLOAT);
+	SetShaderValue(st->gradient_shader, st->contrast_ref_loc, &contrast_ref, SHADER_UNIFORM_FLOAT);
+	BeginShaderMode(st->gradient_shader);
+	// texture bindings only last until the batch is drawn, so this goes after
+	// BeginShaderMode's flush
+	SetShaderValueTexture(st->gradient_shader, st->gamut_lut_loc, st->gamut_tex);
+	hud_draw_texture_pro(st->slice_tex, (Rectangle) { 0, 0, 256, 256 }, (Rectangle) { x, y, w, h },
+						 (Vector2) { 0, 0 }, 0., WHITE);
+	EndShaderMode();
+}
+
+const char *cube_uniform_names[CUBE_UNIFORMS] = {
+	"eye", "cam_right", "cam_up", "cam_fwd", "space", "which_fixed", "fixed_value",
+	"marker", "marker_color"
+};
+
+const char *cube_fs =
+	"#version 330\n"
+	"in vec2 fragTexCoord;\n"
+	"in vec4 fragColor;\n"
+	"out vec4 finalColor;\n"
+	"uniform vec3 eye;\n" // camera, in the unit cube's coordinates: x red, y green, z blue
+	"uniform vec3 cam_right;\n"
+	"uniform vec3 cam_up;\n"
+	"uniform vec3 cam_fwd;\n"
+	"uniform int space;\n"
+	"uniform int which_fixed;\n"
+	"uniform float fixed_value;\n"
+	"uniform vec3 marker;\n" // current color
+	"uniform vec3 marker_color;\n"
+	"const float N = 64.0;\n" // CUBE_N
+	"const float DOT = 0.3;\n" // radius of the off-slice dots, in cells
+	"const float DOT_ALPHA = 0.12;\n"
+	"const float BAND = 0.55*255.0/(N - 1.0);\n" // half a lattice step, in 0-255 steps
+	"const vec3 LIGHT = vec3(0.48, 0.64, 0.6);\n"
+	"float slice_component(vec3 c)\n" // the inverse of slice_color for one component: rgb_to_space
+	"{\n"
+	"	if (space == 0) {\n"
+	"		return c[which_fixed]*255.0;\n"
+	"	}\n"
+	"	if (space == 1 || space == 2) {\n"
+	"		float mx = max(c.r, max(c.g, c.b)), mn = min(c.r, min(c.g, c.b)), d = mx - mn;\n"
+	"		if (which_fixed == 0) {\n"
+	"			float h = d == 0.0 ? 0.0 : mx == c.r ? mod((c.g - c.b)/d, 6.0) : mx == c.g ? (c.b - c.r)/d + 2.0 : (c.r - c.g)/d + 4.0;\n"
+	"			return h/6.0*256.0;\n"
+	"		}\n"
+	"		if (space == 1) {\n"
+	"			return (which_fixed == 1 ? (mx == 0.0 ? 0.0 : d/mx) : mx)*255.0;\n"
+	"		}\n"
+	"		float l = (mx + mn)/2.0;\n"
+	"		return (which_fixed == 1 ? (d == 0.0 ? 0.0 : d/(1.0 - abs(2.0*l - 1.0))) : l)*255.0;\n"
+	"	}\n"
+	"	vec3 lin = mix(c/12.92, pow((c + 0.055)/1.055, vec3(2.4)), step(0.04045, c));\n" // linear_to_oklab
+	"	vec3 lms = pow(lin*mat3(0.4122214708, 0.5363299433, 0.0514459929,\n"
+	"							0.2119034982, 0.6806995451, 0.1073969566,\n"
+	"							0.0883024619, 0.2817188376, 0.6299787005), vec3(1.0/3.0));\n"
+	"	vec3 lab = lms*mat3(0.2104542553, 0.7936177850, -0.0040720468,\n"
+	"						1.9779984951, -2.4285922050, 0.4505937099,\n"
+	"						0.0259040371, 0.7827717662, -0.8086757660);\n"
+	"	vec3 k = space == 3 ? vec3(lab.x, lab.yz/0.8 + 0.5)*255.0\n"
+	"		: vec3(lab.x*255.0, length(lab.yz)/0.4*255.0, mod(atan(lab.z, lab.y)/6.28318531, 1.0)*256.0);\n"
+	"	return k[which_fixed];\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 uv = fragTexCoord*2.0 - 1.0;\n"
+	"	vec3 dir = normalize(cam_fwd*2.75 + uv.x*cam_right - uv.y*cam_up);\n" // CUBE_FOCAL
+	"	dir = mix(dir, vec3(1e-6), equal(dir, vec3(0.0)));\n"
+	"	vec3 inv = 1.0/dir;\n"
+	"	vec3 t0 = -eye*inv, t1 = (1.0 - eye)*inv;\n"
+	"	vec3 tlo = min(t0, t1), thi = max(t0, t1);\n"
+	"	float tin = max(max(tlo.x, tlo.y), max(tlo.z, 0.0)), tout = min(thi.x, min(thi.y, thi.z));\n"
+	"	bool hue = (which_fixed == 0 && (space == 1 || space == 2)) || (which_fixed == 2 && space == 4);\n"
+	"	vec4 acc = vec4(0.0);\n" // premultiplied, front to back
+	"	if (tin < tout) {\n"
+	"		vec3 cell = clamp(floor((eye + dir*tin)*N), 0.0, N - 1.0);\n"
+	"		vec3 stp = sign(dir);\n"
+	"		vec3 tdelta = abs(inv)/N;\n"
+	"		vec3 tnext = ((cell + max(stp, 0.0))/N - eye)*inv;\n"
+	"		vec3 face = step(vec3(tin), tlo);\n" // axis of the face the ray is in through
+	"		for (int i = 0; i < 3*64 && acc.a < 0.98; i++) {\n"
+	"			vec3 c = cell/(N - 1.0);\n"
+	"			float d = abs(slice_component(c) - fixed_value);\n"
+	"			if (hue) {\n"
+	"				d = min(d, 256.0 - d);\n"
+	"			}\n"
+	"			if (d < BAND) {\n"
+	"				float shade = 0.7 + 0.3*abs(dot(face, LIGHT));\n"
+	"				acc += (1.0 - acc.a)*vec4(c*shade, 1.0);\n"
+	"				break;\n"
+	"			}\n"
+	"			vec3 oc = eye - (cell + 0.5)/N;\n"
+	"			float b = dot(oc, dir), h = b*b - dot(oc, oc) + DOT*DOT/(N*N);\n"
+	"			if (h > 0.0) {\n"
+	"				vec3 n = normalize(oc + dir*(-b - sqrt(h)));\n"
+	"				float shade = 0.55 + 0.45*max(dot(n, LIGHT), 0.0);\n"
+	"				acc += (1.0 - acc.a)*DOT_ALPHA*vec4(c*shade, 1.0);\n"
+	"			}\n"
+	"			float t = min(tnext.x, min(tnext.y, tnext.z));\n"
+	"			if (t >= tout) {\n"
+	"				break;\n"
+	"			}\n"
+	"			face = step(tnext, vec3(t));\n"
+	"			cell += stp*face;\n"
+	"			tnext += tdelta*face;\n"
+	"		}\n"
+	"	}\n"
+	"	vec3 m = eye + dir*max(dot(marker - eye, dir), 0.0) - marker;\n"
+	"	if (abs(length(m) - 2.0/N) < 0.6/N) {\n"
+	"		acc = vec4(marker_color, 1.0);\n"
+	"	}\n"
+	"	finalColor = vec4(acc.rgb/max(acc.a, 1e-4), acc.a);\n"
+	"}\n";
+
+// Loaded alongside gradient_shader; leaves cube_shader.id 0 if the driver can't
+// build it, and the cube view is then unavailable.
+void load_cube_shader(struct state *st)
+{
+	st->cube_shader = LoadShaderFromMemory(NULL, cube_fs);
+	for (int i = 0; i < CUBE_UNIFORMS; i++) {
+		st->cube_locs[i] = GetShaderLocation(st->cube_shader, cube_uniform_names[i]);
+		if (st->cube_locs[i] < 0) {
+			TraceLog(LOG_WARNING, "CPICK: cube view shader unavailable");
+			UnloadShader(st->cube_shader);
+			st->cube_shader.id = 0;
+			return;
+		}
+	}
+	st->cube_yaw = 0.8f;
+	st->cube_pitch = 0.45f;
+	st->cube_dist = 2.6f;
+}
+
+void draw_cube(int x, int y, int size, struct state *st)
+{
+	// orbit camera around the cube's center
+	float cp = cosf(st->cube_pitch), sp = sinf(st->cube_pitch);
+	float cy = cosf(st->cube_yaw), sy = sinf(st->cube_yaw);
+	float fwd[3] = { -cp*sy, -sp, -cp*cy };
+	float eye[3] = { 0.5f - st->cube_dist*fwd[0], 0.5f - st->cube_dist*fwd[1], 0.5f - st->cube_dist*fwd[2] };
+	float right[3] = { cy, 0, -sy }; // fwd x (0, 1, 0), normalized
+	float up[3] = { right[1]*fwd[2] - right[2]*fwd[1], right[2]*fwd[0] - right[0]*fwd[2],
+					right[0]*fwd[1] - right[1]*fwd[0] };
+	Color c = current_color(st);
+	float marker[3] = { c.r / 255.f, c.g / 255.f, c.b / 255.f };
+	float marker_color[3] = { st->text_color.r / 255.f, st->text_color.g / 255.f, st->text_color.b / 255.f };
+	float fixed_value = st->fixed_value;
+	int *loc = st->cube_locs;
+	SetShaderValue(st->cube_shader, loc[CUBE_EYE], eye, SHADER_UNIFORM_VEC3);
+	SetShaderValue(st->cube_shader, loc[CUBE_RIGHT], right, SHADER_UNIFORM_VEC3);
+	SetShaderValue(st->cube_shader, loc[CUBE_UP], up, SHADER_UNIFORM_VEC3);
+	SetShaderValue(st->cube_shader, loc[CUBE_FWD], fwd, SHADER_UNIFORM_VEC3);
+	SetShaderValue(st->cube_shader, loc[CUBE_SPACE], &st->space, SHADER_UNIFORM_INT);
+	SetShaderValue(st->cube_shader, loc[CUBE_WHICH_FIXED], &st->which_fixed, SHADER_UNIFORM_INT);
+	SetShaderValue(st->cube_shader, loc[CUBE_FIXED_VALUE], &fixed_value, SHADER_UNIFORM_FLOAT);
+	SetShaderValue(st->cube_shader, loc[CUBE_MARKER], marker, SHADER_UNIFORM_VEC3);
+	SetShaderValue(st->cube_shader, loc[CUBE_MARKER_COLOR], marker_color, SHADER_UNIFORM_VEC3);
+	BeginShaderMode(st->cube_shader);
+	hud_draw_texture_pro(st->slice_tex, (Rectangle) { 0, 0, 256, 256 }, (Rectangle) { x, y, size, size },
+						 (Vector2) { 0, 0 }, 0., WHITE);
+	EndShaderMode();
+}
+
+// Dragging in the square turns the cube, a full turn per square width, and the
+// wheel moves the camera in and out.
+void cube_input(struct state *st, Rectangle square, bool held, Vector2 held_pos)
+{
+	struct input *in = &st->input;
+	if (held && (st->cube_dragging || CheckCollisionPointRec(held_pos, square))) {
+		if (st->cube_dragging) {
+			float turn = 2*PI / square.width;
+			st->cube_yaw -= (held_pos.x - st->cube_drag_pos.x)*turn;
+			st->cube_pitch += (held_pos.y - st->cube_drag_pos.y)*turn;
+			st->cube_pitch = MIN(1.5f, MAX(-1.5f, st->cube_pitch));
+		}
+		st->cube_dragging = true;
+		st->cube_drag_pos = held_pos;
+	}
+	if (!in->down) {
+		st->cube_dragging = false;
+	}
+	if (in->wheel != 0 && CheckCollisionPointRec(in->pos, square)) {
+		st->cube_dist = MIN(CUBE_DIST_MAX, MAX(CUBE_DIST_MIN, st->cube_dist*powf(0.9f, in->wheel)));
+	}
+}
+
+// Same placement rules as raylib's DrawTextEx/DrawTextCodepoint, but the quads are
+// stored in tc so redrawing the text is just the texture draws.
+void layout_text(struct text_cache *tc, Font font, Vector2 pos, float size, float spacing)
+{
+	float scale = size / font.baseSize;
+	float pad = font.glyphPadding;
+	float offset_x = 0;
+	tc->nquads = 0;
+	for (const char *c = tc->text; *c; c++) {
+		int i = GetGlyphIndex(font, *c);
+		Rectangle rec = font.recs[i];
+		if (*c != ' ' && *c != '\t') {
+			tc->src[tc->nquads] = (Rectangle) { rec.x - pad, rec.y - pad, rec.width + 2*pad, rec.height + 2*pad };
+			tc->dst[tc->nquads] = (Rectangle) {
+				pos.x + offset_x + (font.glyphs[i].offsetX - pad)*scale,
+				pos.y + (font.glyphs[i].offsetY - pad)*scale,
+				(rec.width + 2*pad)*scale,
+				(rec.height + 2*pad)*scale
+			};
+			tc->nquads++;
+		}
+		if (font.glyphs[i].advanceX == 0) {
+			offset_x += rec.width*scale + spacing;
+		} else {
+			offset_x += font.glyphs[i].advanceX*scale + spacing;
+		}
+	}
+}
+
+void draw_text_cache(struct text_cache *tc, Font font, Color tint)
+{
+	for (int i = 0; i < tc->nquads; i++) {
+		hud_draw_texture_pro(font.texture, tc->src[i], tc->dst[i], (Vector2) { 0, 0 }, 0., tint);
+	}
+}
+
+// Draws text through tc, laying it out again only if it, pos or size changed.
+void draw_text_cached(struct text_cache *tc, Font font, const char *text, Vector2 pos, float size, Color tint)
+{
+	if (!tc->valid || strcmp(text, tc->text) || pos.x != tc->pos.x || pos.y != tc->pos.y || size != tc->size) {
+		snprintf(tc->text, sizeof(tc->text), "%s", text);
+		layout_text(tc, font, pos, size, 1.5*size/30);
+		tc->pos = pos;
+		tc->size = size;
+		tc->valid = true;
+	}
+	draw_text_cache(tc, font, tint);
+}
+
+#ifdef CPICK_FONT_SDF
+// Distance field text: the atlas stores 0.5 at the glyph edge, and the alpha ramps
+// over about one screen pixel around it at whatever scale the text is drawn.
+const char *text_fs =
+	"#version 330\n"
+	"in vec2 fragTexCoord;\n"
+	"in vec4 fragColor;\n"
+	"out vec4 finalColor;\n"
+	"uniform sampler2D texture0;\n"
+	"uniform vec4 colDiffuse;\n"
+	"void main()\n"
+	"{\n"
+	"	float d = texture(texture0, fragTexCoord).r - 0.5;\n"
+	"	float w = max(fwidth(d), 1e-4);\n" // shapes sample a flat white texel and stay opaque
+	"	finalColor = fragColor*colDiffuse*vec4(1.0, 1.0, 1.0, clamp(d/w + 0.5, 0.0, 1.0));\n"
+	"}\n";
+#endif
+
+// With a distance field font, load text_fs. If the driver can't build it, turn the
+// atlas into plain coverage instead: softer, but readable at the UI's sizes.
+void load_text_shader(struct state *st)
+{
+#ifdef CPICK_FONT_SDF
+	st->text_shader = LoadShaderFromMemory(NULL, text_fs);
+	if (st->text_shader.id != rlGetShaderIdDefault()) {
+		st->text_sdf = true;
+		return;
+	}
+	TraceLog(LOG_WARNING, "CPICK: no text shader, drawing the distance field font as coverage");
+	int w = SDF_ATLAS_WIDTH_NOTOSANSMONOTTF, h = SDF_ATLAS_HEIGHT_NOTOSANSMONOTTF;
+	unsigned char *pixels = malloc(2*w*h);
+	for (int i = 0; i < w*h; i++) {
+		float d = (fontData_NotoSansMonoTtf[i] - 128) * SDF_SPREAD_NOTOSANSMONOTTF / 127.f; // texels
+		// the UI draws at about half the atlas size, so a texel is about half a pixel
+		float a = MIN(1, MAX(0, 0.5f + 0.5f*d));
+		pixels[2*i] = 255;
+		pixels[2*i + 1] = a*255 + 0.5f;
+	}
+	Image img = { pixels, w, h, 1, PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA };
+	UnloadTexture(st->text_font.texture);
+	st->text_font.texture = LoadTextureFromImage(img);
+	SetTextureFilter(st->text_font.texture, TEXTURE_FILTER_BILINEAR);
+	free(pixels);
+#else
+	(void) st;
+#endif
+}
+
+// Bracket text drawing; only distance field text needs its shader.
+void text_begin(struct state *st)
+{
+	if (st->text_sdf) {
+		BeginShaderMode(st->text_shader);
+	}
+}
+
+void text_end(struct state *st)
+{
+	if (st->text_sdf) {
+		EndShaderMode();
+	}
+}
+
+/*
+ * Color text formats, shared by the readout and --convert. Formatting writes into
+ * a caller's buffer and returns the end, with table lookups for the hex digits and
+ * byte values rather than printf, since --convert runs them millions of times.
+ */
+enum format { FMT_HEX, FMT_RGB, FMT_HSV, FMT_HSL, FMT_OKLAB, FMT_OKLCH, FMT_COUNT };
+
+const char *format_names[FMT_COUNT] = { "hex", "rgb", "hsv", "hsl", "oklab", "oklch" };
+
+const char hex_digits[] = "0123456789abcdef";
+signed char hex_value[256]; // -1 for anything that isn't a hex digit
+char byte_text[256][4]; // "0" to "255"
+unsigned char byte_len[256];
+
+void init_formats(void)
+{
+	memset(hex_value, -1, sizeof(hex_value));
+	for (int i = 0; i < 16; i++) {
+		hex_value[(unsigned char) hex_digits[i]] = i;
+		hex_value[(unsigned char) "0123456789ABCDEF"[i]] = i;
+	}
+	for (int i = 0; i < 256; i++) {
+		byte_len[i] = snprintf(byte_text[i], sizeof(byte_text[i]), "%d", i);
+	}
+}
+
+static inline char *put_str(char *p, const char *s)
+{
+	while (*s) {
+		*p++ = *s++;
+	}
+	return p;
+}
+
+static inline char *put_byte(char *p, int v)
+{
+	memcpy(p, byte_text[v], 4);
+	return p + byte_len[v];
+}
+
+// v rounded to a fixed number of decimals, like %.<decimals>f
+char *put_fixed(char *p, float v, int decimals)
+{
+	static const float scale[] = { 1, 10, 100, 1000, 10000 };
+	long n = lroundf(fabsf(v) * scale[decimals]);
+	if (v < 0 && n) {
+		*p++ = '-';
+	}
+	char digits[24];
+	int len = 0;
+	do {
+		digits[len++] = '0' + n % 10;
+		n /= 10;
+	} while (n || len <= decimals);
+	while (len > decimals) {
+		*p++ = digits[--len];
+	}
+	if (decimals) {
+		*p++ = '.';
+		while (len) {
+			*p++ = digits[--len];
+		}
+	}
+	return p;
+}
+
+char *put_hex(char *p, Color c)
+{
+	*p++ = '#';
+	*p++ = hex_digits[c.r >> 4];
+	*p++ = hex_digits[c.r & 15];
+	*p++ = hex_digits[c.g >> 4];
+	*p++ = hex_digits[c.g & 15];
+	*p++ = hex_digits[c.b >> 4];
+	*p++ = hex_digits[c.b & 15];
+	return p;
+}
+
+char *put_oklch(char *p, float l, float c, float h)
+{
+	p = put_str(p, "oklch(");
+	p = put_fixed(p, l, 3);
+	*p++ = ' ';
+	p = put_fixed(p, c, 3);
+	*p++ = ' ';
+	p = put_fixed(p, h, 1);
+	*p++ = ')';
+	return p;
+}
+
+void oklab_to_lch(const float lab[3], float lch[3])
+{
+	lch[0] = lab[0];
+	lch[1] = hypotf(lab[1], lab[2]);
+	lch[2] = lch[1] > 1e-4f ? fmodf(atan2f(lab[2], lab[1]) * 180 / PI + 360, 360) : 0;
+}
+
+// At most 40 characters.
+char *put_color(char *p, int format, Color c)
+{
+	float f[3] = { c.r / 255.f, c.g / 255.f, c.b / 255.f }, v[3];
+	switch (format) {
+		case FMT_HEX:
+			return put_hex(p, c);
+		case FMT_RGB:
+			p = put_str(p, "rgb(");
+			p = put_byte(p, c.r);
+			*p++ = ' ';
+			p = put_byte(p, c.g);
+			*p++ = ' ';
+			p = put_byte(p, c.b);
+			*p++ = ')';
+			return p;
+		case FMT_HSV:
+		case FMT_HSL:
+			rgb_to_hsx(format == FMT_HSL, f, v);
+			p = put_str(p, format == FMT_HSL ? "hsl(" : "hsv(");
+			p = put_fixed(p, v[0]*360, 1);
+			*p++ = ' ';
+			p = put_fixed(p, v[1]*100, 1);
+			*p++ = '%';
+			*p++ = ' ';
+			p = put_fixed(p, v[2]*100, 1);
+			*p++ = '%';
+			*p++ = ')';
+			return p;
+		case FMT_OKLAB:
+			rgb_to_oklab(c, v);
+			p = put_str(p, "oklab(");
+			p = put_fixed(p, v[0], 3);
+			*p++ = ' ';
+			p = put_fixed(p, v[1], 3);
+			*p++ = ' ';
+			p = put_fixed(p, v[2], 3);
+			*p++ = ')';
+			return p;
+		default: {
+			float lch[3];
+			rgb_to_oklab(c, v);
+			oklab_to_lch(v, lch);
+			return put_oklch(p, lch[0], lch[1], lch[2]);
+		}
+	}
+}
+
+// A plain decimal number starting at p; *percent says whether a '%' followed it.
+const char *parse_number(const char *p, const char *end, float *v, bool *percent)
+{
+	if (p == end) {
+		return NULL;
+	}
+	bool neg = *p == '-';
+	p += neg;
+	float n = 0, scale = 1;
+	bool digits = false;
+	while (p < end && *p >= '0' && *p <= '9') {
+		n = n*10 + (*p++ - '0');
+		digits = true;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && *p >= '0' && *p <= '9') {
+			n = n*10 + (*p++ - '0');
+			scale *= 10;
+			digits = true;
+		}
+	}
+	if (!digits) {
+		return NULL;
+	}
+	*v = (neg ? -n : n) / scale;
+	*percent = p < end && *p == '%';
+	return p + *percent;
+}
+
+// Whitespace with at most one ',' or '/' in it, as between the numbers of a color;
+// NULL if there is none.
+const char *parse_separator(const char *p, const char *end)
+{
+	const char *start = p;
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	if (p < end && (*p == ',' || *p == '/')) {
+		p++;
+	}
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	return p > start ? p : NULL;
+}
+
+// True if only whitespace is left, after the ')' closing a function form if paren.
+bool parse_done(const char *p, const char *end, bool paren)
+{
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	if (paren) {
+		if (p == end || *p != ')') {
+			return false;
+		}
+		p++;
+	}
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	return p == end;
+}
+
+// One color in format from [p, end), in any of the forms put_color writes or just
+// the bare numbers ("255 0 0", "ff0000" and "#f00" all work). The numbers are
+// separated by whitespace, ',' or '/', and the only function form taken is the
+// format's own, so "foo 1 2 3", "hsl(120 50% 50%)" as rgb, "1 2 3 4" and
+// "rgb(1 2 3" are all invalid. Out of gamut OK colors are mapped into sRGB.
+bool parse_color(int format, const char *p, const char *end, Color *out)
+{
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	if (format == FMT_HEX) {
+		p += p < end && *p == '#';
+		int n = 0;
+		int d[6];
+		while (p + n < end && n < 6 && hex_value[(unsigned char) p[n]] >= 0) {
+			d[n] = hex_value[(unsigned char) p[n]];
+			n++;
+		}
+		if (!parse_done(p + n, end, false)) {
+			return false;
+		}
+		if (n == 3) {
+			*out = (Color) { d[0]*17, d[1]*17, d[2]*17, 255 };
+		} else if (n == 6) {
+			*out = (Color) { d[0]*16 + d[1], d[2]*16 + d[3], d[4]*16 + d[5], 255 };
+		} else {
+			return false;
+		}
+		return true;
+	}
+	size_t name_len = strlen(format_names[format]);
+	bool paren = (size_t) (end - p) > name_len && !strncasecmp(p, format_names[format], name_len) &&
+		p[name_len] == '(';
+	if (paren) {
+		p += name_len + 1;
+		while (p < end && (*p == ' ' || *p == '\t')) {
+			p++;
+		}
+	}
+	float v[3];
+	bool percent[3];
+	for (int i = 0; i < 3; i++) {
+		if (i > 0) {
+			p = parse_separator(p, end);
+		}
+		p = p ? parse_number(p, end, &v[i], &percent[i]) : NULL;
+		if (!p) {
+			return false;
+		}
+	}
+	if (!parse_done(p, end, paren)) {
+		return false;
+	}
+	float rgb[3];
+	switch (format) {
+		case FMT_RGB:
+			for (int i = 0; i < 3; i++) {
+				rgb[i] = percent[i] ? v[i] / 100 : v[i] / 255;
+			}
+			break;
+		case FMT_HSV:
+		case FMT_HSL: {
+			float hsx[3] = { fmodf(v[0] / 360 + 1, 1), v[1] / 100, v[2] / 100 };
+			hsx_to_rgb(format == FMT_HSL, hsx, rgb);
+			break;
+		}
+		default: {
+			float lab[3] = { percent[0] ? v[0] / 100 : v[0], v[1], v[2] };
+			if (format == FMT_OKLCH) {
+				float h = v[2] * PI / 180;
+				lab[1] = v[1]*cosf(h);
+				lab[2] = v[1]*sinf(h);
+			}
+			*out = oklab_to_rgb(lab);
+			return true;
+		}
+	}
+	*out = (Color) { fminf(1, fmaxf(0, rgb[0]))*255 + 0.5f, fminf(1, fmaxf(0, rgb[1]))*255 + 0.5f,
+					 fminf(1, fmaxf(0, rgb[2]))*255 + 0.5f, 255 };
+	return true;
+}
+
+// The named color palette and its grid, see struct palette.
+static inline int palette_cell_coord(float v, float lo, float hi)
+{
+	int i = (v - lo) / (hi - lo) * PALETTE_GRID;
+	return i < 0 ? 0 : i >= PALETTE_GRID ? PALETTE_GRID - 1 : i;
+}
+
+static inline void palette_cell(const float lab[3], int cell[3])
+{
+	cell[0] = palette_cell_coord(lab[0], 0, 1);
+	cell[1] = palette_cell_coord(lab[1], -OK_AB_MAX, OK_AB_MAX);
+	cell[2] = palette_cell_coord(lab[2], -OK_AB_MAX, OK_AB_MAX);
+}
+
+void palette_add(struct palette *p, const char *name, int len, Color rgb)
+{
+	if (p->n == p->cap) {
+		p->cap = p->cap ? 2*p->cap : 256;
+		p->colors = realloc(p->colors, p->cap*sizeof(struct named_color));
+	}
+	struct named_color *nc = &p->colors[p->n++];
+	len = MIN(len, PALETTE_NAME_LEN - 1);
+	memcpy(nc->name, name, len);
+	nc->name[len] = '\0';
+	nc->rgb = (Color) { rgb.r, rgb.g, rgb.b, 255 };
+	rgb_to_oklab(nc->rgb, nc->lab);
+}
+
+// One color per line, as "#rrggbb name", "name #rrggbb" or rgb.txt's "r g b name".
+// Blank lines and lines starting with '!' are skipped, as are lines that are none
+// of these (so GIMP .gpl headers or '#' comments do no harm).
+bool palette_load(struct palette *p, const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "cpick: can't open palette %s\n", path);
+		return false;
+	}
+	char line[256];
+	int skipped = 0;
+	while (fgets(line, sizeof(line), f)) {
+		const char *s = line;
+		const char *end = line + strcspn(line, "\r\n");
+		while (s < end && (*s == ' ' || *s == '\t')) {
+			s++;
+		}
+		if (s == end || *s == '!') {
+			continue;
+		}
+		Color c;
+		const char *name = NULL, *name_end = end;
+		if (*s == '#') {
+			const char *tok = s + strcspn(s, " \t\r\n");
+			if ((tok - s == 4 || tok - s == 7) && parse_color(FMT_HEX, s, tok, &c)) {
+				name = tok;
+			}
+		} else if (*s >= '0' && *s <= '9') {
+			const char *q = s;
+			float v[3];
+			bool percent;
+			int i;
+			for (i = 0; i < 3 && q; i++) {
+				while (q < end && (*q == ' ' || *q == '\t')) {
+					q++;
+				}
+				q = parse_number(q, end, &v[i], &percent);
+				q = q && v[i] <= 255 && !percent && v[i] == (int) v[i] ? q : NULL;
+			}
+			if (q) {
+				c = (Color) { v[0], v[1], v[2], 255 };
+				name = q;
+			}
+		} else {
+			const char *hash = memchr(s, '#', end - s);
+			if (hash && parse_color(FMT_HEX, hash, end, &c)) {
+				name = s;
+				name_end = hash;
+			}
+		}
+		if (name) {
+			while (name < name_end && (*name == ' ' || *name == '\t')) {
+				name++;
+			}
+			while (name_end > name && (name_end[-1] == ' ' || name_end[-1] == '\t')) {
+				name_end--;
+			}
+		}
+		if (!name || name == name_end) {
+			skipped++;
+			continue;
+		}
+		palette_add(p, name, name_end - name, c);
+	}
+	fclose(f);
+	if (skipped) {
+		TraceLog(LOG_WARNING, "CPICK: %s: skipped %d lines that aren't a color and a name", path, skipped);
+	}
+	return true;
+}
+
+// Buckets the colors into the grid; call once all of them are added.
+void palette_build_index(struct palette *p)
+{
+	int *cells = malloc(p->n*sizeof(int));
+	memset(p->start, 0, sizeof(p->start));
+	for (int i = 0; i < p->n; i++) {
+		int c[3];
+		palette_cell(p->colors[i].lab, c);
+		cells[i] = (c[0]*PALETTE_GRID + c[1])*PALETTE_GRID + c[2];
+		p->start[cells[i] + 1]++;
+	}
+	for (int c = 0; c < PALETTE_CELLS; c++) {
+		p->start[c + 1] += p->start[c];
+	}
+	int *fill = malloc(PALETTE_CELLS*sizeof(int));
+	memcpy(fill, p->start, PALETTE_CELLS*sizeof(int));
+	p->items = realloc(p->items, p->n*sizeof(int));
+	for (int i = 0; i < p->n; i++) {
+		p->items[fill[cells[i]]++] = i;
+	}
+	free(fill);
+	free(cells);
+}
+
+// The user's palette, then the CSS colors, so the user's names win ties.
+bool palette_init(struct palette *p, const char *path)
+{
+	init_formats();
+	init_ok_tables();
+	if (path && !palette_load(p, path)) {
+		return false;
+	}
+	for (int i = 0; i < (int) (sizeof(css_colors)/sizeof(css_colors[0])); i++) {
+		palette_add(p, css_colors[i].name, strlen(css_colors[i].name),
+					(Color) { css_colors[i].r, css_colors[i].g, css_colors[i].b, 255 });
+	}
+	palette_build_index(p);
+	return true;
+}
+
+void palette_free(struct palette *p)
+{
+	free(p->colors);
+	free(p->items);
+	*p = (struct palette) { 0 };
+}
+
+/*
+ * Nearest color by OKLab distance, with the distance in *dist. Searches shells of
+ * cells around rgb's cell, nearest first: anything in shell r+1 or beyond is at
+ * least r whole cells away, so once the best match is that close we can stop.
+ */
+const struct named_color *palette_nearest(const struct palette *p, Color rgb, float *dist)
+{
+	if (p->n == 0) {
+		return NULL;
+	}
+	float lab[3];
+	int cell[3];
+	rgb_to_oklab(rgb, lab);
+	palette_cell(lab, cell);
+	int best = -1;
+	float best_d2 = INFINITY;
+	for (int r = 0; r < PALETTE_GRID; r++) {
+		for (int dl = -r; dl <= r; dl++) {
+			int cl = cell[0] + dl;
+			if (cl < 0 || cl >= PALETTE_GRID) {
+				continue;
+			}
+			for (int da = -r; da <= r; da++) {
+				int ca = cell[1] + da;
+				if (ca < 0 || ca >= PALETTE_GRID) {
+					continue;
+				}
+				// inside the shell only its two b faces are new
+				bool face = dl == -r || dl == r || da == -r || da == r;
+				for (int db = -r; db <= r; db += face ? 1 : 2*r) {
+					int cb = cell[2] + db;
+					if (cb < 0 || cb >= PALETTE_GRID) {
+						continue;
+					}
+					int c = (cl*PALETTE_GRID + ca)*PALETTE_GRID + cb;
+					for (int k = p->start[c]; k < p->start[c + 1]; k++) {
+						int i = p->items[k];
+						const float *v = p->colors[i].lab;
+						float d2 = (v[0] - lab[0])*(v[0] - lab[0]) + (v[1] - lab[1])*(v[1] - lab[1]) +
+								   (v[2] - lab[2])*(v[2] - lab[2]);
+						if (d2 < best_d2 || (d2 == best_d2 && i < best)) {
+							best = i;
+							best_d2 = d2;
+						}
+					}
+				}
+			}
+		}
+		if (best >= 0 && best_d2 <= (r*PALETTE_CELL_MIN)*(r*PALETTE_CELL_MIN)) {
+			break;
+		}
+	}
+	*dist = sqrtf(best_d2);
+	return &p->colors[best];
+}
+
+// mkdir -p for the directories above path
+void make_parent_dirs(const char *path)
+{
+	char dir[PATH_MAX];
+	snprintf(dir, sizeof(dir), "%s", path);
+	for (char *p = dir + 1; *p; p++) {
+		if (*p == '/') {
+			*p = '\0';
+			mkdir(dir, 0755);
+			*p = '/';
+		}
+	}
+}
+
+bool history_map(struct history *h, size_t size)
+{
+	if (h->map) {
+		munmap(h->map, h->size);
+		h->map = NULL;
+	}
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, h->fd, 0);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	h->map = map;
+	h->size = size;
+	h->records = (struct history_record *) (h->map + 1);
+	return true;
+}
+
+static inline uint64_t history_capacity(struct history *h)
+{
+	return (h->size - sizeof(struct history_header)) / sizeof(struct history_record);
+}
+
+// The records this mapping can see; another cpick may have appended past it.
+static inline uint64_t history_count(struct history *h)
+{
+	return h->map ? MIN(__atomic_load_n(&h->map->count, __ATOMIC_ACQUIRE), history_capacity(h)) : 0;
+}
+
+// path NULL: $XDG_DATA_HOME/cpick/history, or ~/.local/share/cpick/history
+void history_open(struct history *h, const char *path)
+{
+	char buf[PATH_MAX];
+	if (!path) {
+		const char *data = getenv("XDG_DATA_HOME");
+		const char *home = getenv("HOME");
+		if (data && *data) {
+			snprintf(buf, sizeof(buf), "%s/cpick/history", data);
+		} else if (home && *home) {
+			snprintf(buf, sizeof(buf), "%s/.local/share/cpick/history", home);
+		} else {
+			return;
+		}
+		path = buf;
+	}
+	make_parent_dirs(path);
+	h->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (h->fd < 0) {
+		TraceLog(LOG_WARNING, "CPICK: no history, can't open %s", path);
+		return;
+	}
+	flock(h->fd, LOCK_EX);
+	struct stat sb;
+	if (fstat(h->fd, &sb) || sb.st_size < 0) {
+		TraceLog(LOG_WARNING, "CPICK: no history, can't stat %s", path);
+		flock(h->fd, LOCK_UN);
+		close(h->fd);
+		return;
+	}
+	bool fresh = sb.st_size == 0;
+	size_t size = fresh ? sizeof(struct history_header) + HISTORY_MIN_CAP*sizeof(struct history_record) :
+		(size_t) sb.st_size;
+	if ((fresh && ftruncate(h->fd, size)) || size < sizeof(struct history_header) || !history_map(h, size)) {
+		TraceLog(LOG_WARNING, "CPICK: no history, can't map %s", path);
+	} else if (fresh) {
+		memcpy(h->map->magic, HISTORY_MAGIC, 8);
+		h->map->record_size = sizeof(struct history_record);
+	} else if (memcmp(h->map->magic, HISTORY_MAGIC, 8) || h->map->record_size != sizeof(struct history_record) ||
+			   (size - sizeof(struct history_header)) % sizeof(struct history_record)) {
+		// not ours, from an incompatible version, or cut short: leave it alone
+		TraceLog(LOG_WARNING, "CPICK: no history, %s isn't a cpick history file", path);
+		munmap(h->map, h->size);
+		h->map = NULL;
+	}
+	flock(h->fd, LOCK_UN);
+	if (!h->map) {
+		close(h->fd);
+	}
+}
+
+void history_close(struct history *h)
+{
+	if (h->map) {
+		munmap(h->map, h->size);
+		close(h->fd);
+		h->map = NULL;
+	}
+}
+
+// Appends r unless it repeats the newest record. The lock keeps two cpicks (say,
+// the daemon and a one-off window) from writing the same slot.
+void history_append(struct history *h, const struct history_record *r)
+{
+	if (!h->map) {
+		return;
+	}
+	flock(h->fd, LOCK_EX);
+	struct stat sb;
+	if (!fstat(h->fd, &sb) && sb.st_size >= 0 && (size_t) sb.st_size != h->size && !history_map(h, (size_t) sb.st_size)) {
+		goto out;
+	}
+	uint64_t n = history_count(h);
+	if (n > 0 && !memcmp(&h->records[n - 1].r, &r->r, offsetof(struct history_record, reserved) - offsetof(struct history_record, r))) {
+		goto out;
+	}
+	if (n == history_capacity(h)) {
+		// a file with no room preallocated doubles from nothing, so start at the minimum
+		size_t size = sizeof(struct history_header) + MAX(2*n, HISTORY_MIN_CAP)*sizeof(struct history_record);
+		if (ftruncate(h->fd, size) || !history_map(h, size)) {
+			TraceLog(LOG_WARNING, "CPICK: history is full and can't grow");
+			goto out;
+		}
+	}
+	h->records[n] = *r;
+	__atomic_store_n(&h->map->count, n + 1, __ATOMIC_RELEASE); // record first, then the count
+	h->scroll = 0;
+out:
+	flock(h->fd, LOCK_UN);
+}
+
+// i = 0 is the newest
+static inline const struct history_record *history_get(struct history *h, uint64_t i)
+{
+	return &h->records[history_count(h) - 1 - i];
+}
+
+// A record of c, picked at the given slice position in the current space.
+struct history_record history_make(struct state *st, Color c, int fixed_value, int x_value, int y_value)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	struct history_record r = {
+		.time = (int64_t) ts.tv_sec*1000 + ts.tv_nsec/1000000,
+		.r = c.r, .g = c.g, .b = c.b,
+		.space = st->space,
+		.which_fixed = st->which_fixed,
+		.fixed_value = fixed_value,
+		.x_value = x_value,
+		.y_value = y_value,
+	};
+	return r;
+}
+
+void history_add(struct state *st, Color c, int fixed_value, int x_value, int y_value)
+{
+	struct history_record r = history_make(st, c, fixed_value, x_value, y_value);
+	history_append(&st->history, &r);
+}
+
+void history_add_current(struct state *st)
+{
+	history_add(st, current_color(st), st->fixed_value, st->x_value, st->y_value);
+}
+
+// Back to the slice and point a record was picked at.
+void history_restore(struct state *st, const struct history_record *r)
+{
+	if (r->space >= SPACE_COUNT || r->which_fixed > 2) {
+		return;
+	}
+	st->space = r->space;
+	st->which_fixed = r->which_fixed;
+	st->fixed_value = r->fixed_value;
+	st->x_value = r->x_value;
+	st->y_value = r->y_value;
+}
+
+/*
+ * Palette extraction (--extract FILE, or an image dropped on the window). Pixels
+ * are first binned into a 32^3 RGB histogram, one per worker so the pass needs no
+ * locks, which leaves at most 32768 weighted colors however big the image is.
+ * Those are clustered with k-means in OKLab, seeded with the heaviest bin and
+ * then whichever bin is heaviest for its distance to the seeds so far, so the
+ * result is deterministic. The points are kept as separate arrays so the
+ * assignment loop vectorizes.
+ */
+#define EXTRACT_BITS 5
+#define EXTRACT_BINS (1 << 3*EXTRACT_BITS)
+#define EXTRACT_MAX_K 32
+#define EXTRACT_ITERATIONS 32
+
+struct extract_bin {
+	uint64_t sum[3];
+	uint32_t n;
+};
+
+struct extract_job {
+	const unsigned char *pixels;
+	size_t npixels;
+	int bpp; // bytes per pixel
+	int alpha; // byte offset of alpha, -1: opaque
+	bool gray;
+	int chunks;
+	struct extract_bin *hist; // chunks histograms
+};
+
+// Bins chunk [begin, end) of the pixels, each chunk into its own histogram.
+void extract_bin_chunks(void *ctx, int begin, int end)
+{
+	struct extract_job *job = ctx;
+	for (int k = begin; k < end; k++) {
+		struct extract_bin *hist = job->hist + (size_t) k*EXTRACT_BINS;
+		size_t first = job->npixels*k / job->chunks, last = job->npixels*(k + 1) / job->chunks;
+		const unsigned char *p = job->pixels + first*job->bpp;
+		for (size_t i = first; i < last; i++, p += job->bpp) {
+			if (job->alpha >= 0 && p[job->alpha] < 128) {
+				continue;
+			}
+			unsigned r = p[0], g = job->gray ? r : p[1], b = job->gray ? r : p[2];
+			struct extract_bin *bin = hist + ((r >> (8 - EXTRACT_BITS)) << 2*EXTRACT_BITS |
+											  (g >> (8 - EXTRACT_BITS)) << EXTRACT_BITS | b >> (8 - EXTRACT_BITS));
+			bin->sum[0] += r;
+			bin->sum[1] += g;
+			bin->sum[2] += b;
+			bin->n++;
+		}
+	}
+}
+
+// Clusters img's opaque pixels into at most k colors, largest cluster first, and
+// returns how many there are (fewer than k if the image has fewer colors).
+int extract_palette(Image img, int k, Color *out)
+{
+	double t0 = now_seconds();
+	struct extract_job job = { img.data, (size_t) img.width*img.height, 0, -1, false, workers.nthreads + 1, NULL };
+	Image conv = { 0 };
+	switch (img.format) {
+	case PIXELFORMAT_UNCOMPRESSED_GRAYSCALE: job.bpp = 1; job.gray = true; break;
+	case PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA: job.bpp = 2; job.gray = true; job.alpha = 1; break;
+	case PIXELFORMAT_UNCOMPRESSED_R8G8B8: job.bpp = 3; break;
+	case PIXELFORMAT_UNCOMPRESSED_R8G8B8A8: job.bpp = 4; job.alpha = 3; break;
+	default:
+		// 16-bit and float PNGs and the like: go through raylib's (slower) conversion
+		conv = ImageCopy(img);
+		ImageFormat(&conv, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+		job.pixels = conv.data;
+		job.bpp = 4;
+		job.alpha = 3;
+	}
+	job.hist = calloc((size_t) job.chunks*EXTRACT_BINS, sizeof(struct extract_bin));
+	parallel_for(&workers, job.chunks, 1, extract_bin_chunks, &job);
+	UnloadImage(conv);
+
+	// merge the histograms into the non-empty bins, as OKLab points
+	float *pl = malloc(EXTRACT_BINS*4*sizeof(float)), *pa = pl + EXTRACT_BINS, *pb = pa + EXTRACT_BINS, *pw = pb + EXTRACT_BINS;
+	int npoints = 0;
+	for (int i = 0; i < EXTRACT_BINS; i++) {
+		uint64_t sum[3] = { 0, 0, 0 }, n = 0;
+		for (int c = 0; c < job.chunks; c++) {
+			struct extract_bin *bin = job.hist + (size_t) c*EXTRACT_BINS + i;
+			sum[0] += bin->sum[0];
+			sum[1] += bin->sum[1];
+			sum[2] += bin->sum[2];
+			n += bin->n;
+		}
+		if (n) {
+			float rgb[3], lab[3];
+			for (int j = 0; j < 3; j++) {
+				rgb[j] = srgb_decode((float) sum[j] / n / 255);
+			}
+			linear_to_oklab(rgb, lab);
+			pl[npoints] = lab[0];
+			pa[npoints] = lab[1];
+			pb[npoints] = lab[2];
+			pw[npoints] = n;
+			npoints++;
+		}
+	}
+	free(job.hist);
+
+	// seeds
+	k = MIN(k, npoints);
+	float cl[EXTRACT_MAX_K], ca[EXTRACT_MAX_K], cb[EXTRACT_MAX_K], cw[EXTRACT_MAX_K];
+	float *best_d = malloc(npoints*sizeof(float));
+	unsigned char *label = malloc(2*npoints), *prev = label + npoints;
+	for (int i = 0; i < npoints; i++) {
+		best_d[i] = INFINITY;
+	}
+	int seed = 0;
+	for (int c = 0; c < k; c++) {
+		float top = -1;
+		for (int i = 0; i < npoints; i++) {
+			float score = c == 0 ? pw[i] : pw[i]*best_d[i];
+			if (score > top) {
+				top = score;
+				seed = i;
+			}
+		}
+		cl[c] = pl[seed];
+		ca[c] = pa[seed];
+		cb[c] = pb[seed];
+		for (int i = 0; i < npoints; i++) {
+			float dl = pl[i] - cl[c], da = pa[i] - ca[c], db = pb[i] - cb[c];
+			best_d[i] = fminf(best_d[i], dl*dl + da*da + db*db);
+		}
+	}
+
+	// Lloyd iterations, until no point changes cluster
+	memset(label, 0xff, npoints);
+	for (int iter = 0; iter < EXTRACT_ITERATIONS; iter++) {
+		for (int i = 0; i < npoints; i++) {
+			best_d[i] = INFINITY;
+		}
+		memcpy(prev, label, npoints);
+		for (int c = 0; c < k; c++) {
+			for (int i = 0; i < npoints; i++) {
+				float dl = pl[i] - cl[c], da = pa[i] - ca[c], db = pb[i] - cb[c];
+				float d = dl*dl + da*da + db*db;
+				if (d < best_d[i]) {
+					best_d[i] = d;
+					label[i] = c;
+				}
+			}
+		}
+		bool changed = memcmp(prev, label, npoints) != 0;
+		double sl[EXTRACT_MAX_K] = { 0 }, sa[EXTRACT_MAX_K] = { 0 }, sb[EXTRACT_MAX_K] = { 0 }, sw[EXTRACT_MAX_K] = { 0 };
+		for (int i = 0; i < npoints; i++) {
+			int c = label[i];
+			sl[c] += pw[i]*pl[i];
+			sa[c] += pw[i]*pa[i];
+			sb[c] += pw[i]*pb[i];
+			sw[c] += pw[i];
+		}
+		for (int c = 0; c < k; c++) {
+			cw[c] = sw[c];
+			if (sw[c] > 0) {
+				cl[c] = sl[c] / sw[c];
+				ca[c] = sa[c] / sw[c];
+				cb[c] = sb[c] / sw[c];
+			}
+		}
+		if (!changed) {
+			break;
+		}
+	}
+
+	// largest first
+	int order[EXTRACT_MAX_K];
+	for (int c = 0; c < k; c++) {
+		int j = c;
+		for (; j > 0 && cw[order[j-1]] < cw[c]; j--) {
+			order[j] = order[j-1];
+		}
+		order[j] = c;
+	}
+	int n = 0;
+	for (int j = 0; j < k; j++) {
+		int c = order[j];
+		if (cw[c] == 0) {
+			continue;
+		}
+		float lab[3] = { cl[c], ca[c], cb[c] }, rgb[3];
+		oklab_to_linear(lab, rgb);
+		out[n++] = (Color) { srgb_encode(rgb[0])*255 + 0.5f, srgb_encode(rgb[1])*255 + 0.5f,
+							 srgb_encode(rgb[2])*255 + 0.5f, 255 };
+	}
+	free(pl);
+	free(best_d);
+	free(label);
+	TraceLog(LOG_INFO, "CPICK: %d colors from %dx%d pixels (%d bins) in %.1f ms",
+			 n, img.width, img.height, npoints, (now_seconds() - t0)*1000);
+	return n;
+}
+
+// The palette goes in front of the history in the strip, largest cluster first.
+// It is only written to the history file when one of its swatches is picked.
+void extract_to_strip(struct state *st, Image img, int k)
+{
+	Color colors[EXTRACT_MAX_K];
+	int n = extract_palette(img, k, colors);
+	if (!st->extracted) {
+		st->extracted = malloc(EXTRACT_MAX_K*sizeof(struct history_record));
+	}
+	for (int i = 0; i < n; i++) {
+		Color c = rgb_to_space(st->space, colors[i]);
+		unsigned char v[3] = { c.r, c.g, c.b };
+		st->extracted[i] = history_make(st, colors[i], v[CHANNEL_FIXED(st->which_fixed)],
+										v[CHANNEL_X(st->which_fixed)], v[CHANNEL_Y(st->which_fixed)]);
+	}
+	st->nextracted = n;
+	st->history.scroll = 0;
+}
+
+static inline int strip_count(struct state *st)
+{
+	return st->nextracted + history_count(&st->history);
+}
+
+// i = 0 is the leftmost swatch
+static inline const struct history_record *strip_get(struct state *st, int i)
+{
+	return i < st->nextracted ? &st->extracted[i] : history_get(&st->history, i - st->nextracted);
+}
+
+// What Enter prints and the daemon sends back: hex, or with --bits a CSS
+// color(srgb ...) with enough digits for the depth.
+void format_picked(struct state *st, char *buf, size_t n)
+{
+	if (st->deep_bits) {
+		float rgb[3];
+		deep_color(st, rgb);
+		int decimals = st->deep_bits > 12 ? 5 : 4;
+		snprintf(buf, n, "color(srgb %.*f %.*f %.*f)", decimals, rgb[0], decimals, rgb[1], decimals, rgb[2]);
+	} else {
+		*put_hex(buf, current_color(st)) = '\0';
+	}
+}
+
+// OKLCH coordinates of the current point, which may be out of gamut
+void current_oklch(struct state *st, float *l, float *c, float *h)
+{
+	Color v = slice_color(st->which_fixed, st->fixed_value, st->x_value, st->y_value);
+	*l = v.r / 255.f;
+	if (st->space == SPACE_OKLCH) {
+		*c = v.g / 255.f * OK_C_MAX;
+		*h = v.b * 360.f / 256;
+		return;
+	}
+	float lab[3];
+	ok_to_lab(SPACE_OKLAB, v, lab);
+	*c = hypotf(lab[1], lab[2]);
+	*h = fmodf(atan2f(lab[2], lab[1]) * 180 / PI + 360, 360);
+}
+
+// col: the picked sRGB color (for the OK spaces, the nearest in-gamut one)
+void draw_readout(struct state *st, Color col, Vector2 pos, float size)
+{
+	char text[TEXT_CACHE_MAX];
+	if (st->deep_bits) {
+		float rgb[3];
+		deep_color(st, rgb);
+		int decimals = st->deep_bits > 12 ? 5 : 4;
+		snprintf(text, sizeof(text), "r:%.*f g:%.*f b:%.*f", decimals, rgb[0], decimals, rgb[1], decimals, rgb[2]);
+		size *= 29.f / MAX(29, strlen(text));
+	} else if (st->space == SPACE_OKLAB || st->space == SPACE_OKLCH) {
+		float l, c, h;
+		current_oklch(st, &l, &c, &h);
+		char *p = put_oklch(text, l, c, h);
+		*p++ = ' ';
+		p = put_hex(p, col);
+		*p = '\0';
+		// longer than the rgb line; keep it within the square's width
+		size *= 29.f / strlen(text);
+	} else {
+		snprintf(text, sizeof(text), "r:%-3d g:%-3d b:%-3d hex:#%02x%02x%02x",
+				 col.r, col.g, col.b, col.r, col.g, col.b);
+	}
+	draw_text_cached(&st->readout, st->text_font, text, pos, size, st->text_color);
+}
+
+// The overlay's level and reference, and how the current color does against it.
+void draw_contrast_status(struct state *st, Color col, Vector2 pos, float size)
+{
+	if (!st->contrast_level) {
+		return;
+	}
+	char text[TEXT_CACHE_MAX];
+	char *p = put_str(text, contrast_levels[st->contrast_level].name);
+	p = put_str(p, " vs ");
+	p = put_hex(p, st->contrast_ref);
+	snprintf(p, text + sizeof(text) - p, ": %.1f:1",
+			 contrast_ratio(relative_luminance(col), relative_luminance(st->contrast_ref)));
+	draw_text_cached(&st->contrast_text, st->text_font, text, pos, size, st->text_color);
+}
+
+// Name of the palette color nearest col, with "~" and the OKLab distance when it
+// isn't an exact match.
+void draw_color_name(struct state *st, Color col, Vector2 pos, float size)
+{
+	if (st->palette.n == 0) {
+		return;
+	}
+	if (!st->name_match || col.r != st->name_color.r || col.g != st->name_color.g || col.b != st->name_color.b) {
+		st->name_match = palette_nearest(&st->palette, col, &st->name_dist);
+		st->name_color = col;
+	}
+	const struct named_color *m = st->name_match;
+	char text[TEXT_CACHE_MAX];
+	if (m->rgb.r == col.r && m->rgb.g == col.g && m->rgb.b == col.b) {
+		snprintf(text, sizeof(text), "%s", m->name);
+	} else {
+		snprintf(text, sizeof(text), "~%s (dE %.3f)", m->name, st->name_dist);
+	}
+	draw_text_cached(&st->name_text, st->text_font, text, pos, size, st->text_color);
+}
+
+void hud_begin_frame(struct hud *h)
+{
+	double t = now_seconds();
+	int i = h->frame % HUD_FRAMES;
+	h->frame_t[i] = h->frame ? t - h->frame_start : 0;
+	h->woke[i] = h->frame && h->idle[(h->frame - 1) % HUD_FRAMES];
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		h->stage_t[i][s] = 0;
+	}
+	h->frame_start = t;
+	h->mark = t;
+	draw_call_count = 0;
+}
+
+// Charge the time since the previous mark to stage s.
+void hud_mark(struct hud *h, enum stage s)
+{
+	double t = now_seconds();
+	h->stage_t[h->frame % HUD_FRAMES][s] += t - h->mark;
+	h->mark = t;
+}
+
+// Call after the frame's own drawing, before the HUD draws itself.
+void hud_count_draw_calls(struct hud *h)
+{
+	h->draw_calls[h->frame % HUD_FRAMES] = draw_call_count;
+}
+
+// input_t: timestamp of the newest input sample the frame used; idle: EndDrawing
+// waited for events
+void hud_end_frame(struct hud *h, double input_t, bool idle)
+{
+	h->input_age[h->frame % HUD_FRAMES] = now_seconds() - input_t;
+	h->idle[h->frame % HUD_FRAMES] = idle;
+	h->wait[h->frame % HUD_FRAMES] = pacing.wait;
+	h->frame++;
+}
+
+// p50 and p99 of vals[0..n), n <= HUD_FRAMES
+void percentiles(const double *vals, int n, double *p50, double *p99)
+{
+	double sorted[HUD_FRAMES];
+	for (int i = 0; i < n; i++) {
+		// insertion sort: n is small and this only runs while the HUD is up
+		int j = i;
+		for (; j > 0 && sorted[j-1] > vals[i]; j--) {
+			sorted[j] = sorted[j-1];
+		}
+		sorted[j] = vals[i];
+	}
+	*p50 = n ? sorted[(n-1)/2] : 0;
+	*p99 = n ? sorted[(int) ((n-1)*0.99 + 0.5)] : 0;
+}
+
+void draw_hud(struct state *st)
+{
+	struct hud *h = &st->hud;
+	int n = MIN(h->frame, HUD_FRAMES);
+	if (n == 0) {
+		return;
+	}
+	double vals[HUD_FRAMES];
+	double p50, p99;
+	char line[64];
+	float size = 16;
+	int x = 8, y = 8, line_h = 18;
+	DrawRectangle(x - 4, y - 4, 250, line_h*(STAGE_COUNT + 6) + 8, ColorAlpha(BLACK, 0.7));
+	text_begin(st);
+
+	int m = 0;
+	for (int i = 0; i < n; i++) {
+		if (!h->woke[i]) {
+			vals[m++] = h->frame_t[i];
+		}
+	}
+	percentiles(vals, m, &p50, &p99);
+	snprintf(line, sizeof(line), "frame    p50 %6.2f p99 %6.2f ms", p50*1000, p99*1000);
+	DrawTextEx(st->text_font, line, (Vector2) { x, y }, size, 1, WHITE);
+	y += line_h;
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		m = 0;
+		for (int i = 0; i < n; i++) {
+			if (s != STAGE_SWAP || !h->idle[i]) {
+				vals[m++] = h->stage_t[i][s];
+			}
+		}
+		percentiles(vals, m, &p50, &p99);
+		snprintf(line, sizeof(line), "%-8s p50 %6.3f p99 %6.3f ms", stage_names[s], p50*1000, p99*1000);
+		DrawTextEx(st->text_font, line, (Vector2) { x, y }, size, 1, WHITE);
+		y += line_h;
+	}
+	m = 0;
+	for (int i = 0; i < n; i++) {
+		if (!h->idle[i]) {
+			vals[m++] = h->input_age[i];
+		}
+	}
+	percentiles(vals, m, &p50, &p99);
+	snprintf(line, sizeof(line), "input    p50 %6.2f p99 %6.2f ms", p50*1000, p99*1000);
+	DrawTextEx(st->text_font, line, (Vector2) { x, y }, size, 1, WHITE);
+	y += line_h;
+	for (int i = 0; i < n; i++) {
+		vals[i] = h->draw_calls[i];
+	}
+	percentiles(vals, n, &p50, &p99);
+	snprintf(line, sizeof(line), "draws    p50 %6.0f p99 %6.0f", p50, p99);
+	DrawTextEx(st->text_font, line, (Vector2) { x, y }, size, 1, WHITE);
+	y += line_h;
+	// how this frame was started, at what refresh rate, and the frame cost it was
+	// budgeting for
+	snprintf(line, sizeof(line), "pace     %-8s %3d Hz %5.2f ms", pace_names[pacing.mode], pacing.hz,
+			 pacing.work*1000);
+	DrawTextEx(st->text_font, line, (Vector2) { x, y }, size, 1, WHITE);
+	y += line_h;
+	for (int i = 0; i < n; i++) {
+		vals[i] = h->wait[i];
+	}
+	percentiles(vals, n, &p50, &p99);
+	snprintf(line, sizeof(line), "wait     p50 %6.2f p99 %6.2f ms", p50*1000, p99*1000);
+	DrawTextEx(st->text_font, line, (Vector2) { x, y }, size, 1, WHITE);
+	y += line_h;
+	snprintf(line, sizeof(line), "renderer %s", st->renderer == RENDER_SHADER ? "shader" : "cpu");
+	DrawTextEx(st->text_font, line, (Vector2) { x, y }, size, 1, WHITE);
+	text_end(st);
+}
+
+// The layout is designed for a BASE_W x BASE_H window with a 512px square, and
+// scales uniformly to fit whatever window we actually have.
+#define BASE_W 620
+#define BASE_H 740
+
+struct layout {
+	float scale;
+	int square_size;
+	int y_axis_w;
+	int x_axis_h;
+	int grad_square_x;
+	int grad_square_y;
+	int ind_button_x;
+	int ind_button_y;
+	int ind_button_h;
+	int space_button_x;
+	int space_button_y;
+	int space_button_w;
+	int space_button_h;
+	int pick_button_x; // eyedropper, same size and row as the space button
+	int val_slider_x;
+	int val_slider_y;
+	int val_slider_w;
+	int val_slider_h;
+	Vector2 readout_pos;
+	float readout_size;
+	Vector2 name_pos; // nearest named color, under the readout
+	float name_size;
+	Vector2 contrast_pos; // contrast overlay status, right of the space button
+	float contrast_size;
+	int history_x; // swatch strip, newest on the left
+	int history_y;
+	int swatch_size;
+	int swatch_step;
+	int swatches;
+};
+
+struct layout get_layout(struct state *st)
+{
+	struct layout l;
+	float k = MIN((float) st->screenWidth / BASE_W, (float) st->screenHeight / BASE_H);
+	l.scale = k;
+	l.square_size = roundf(512*k);
+	l.y_axis_w = roundf(30*k);
+	l.x_axis_h = roundf(30*k);
+	l.grad_square_x = (st->screenWidth - l.square_size)/2;
+	l.grad_square_y = roundf(40*k);
+	l.ind_button_x = l.grad_square_x;
+	l.ind_button_y = l.grad_square_y + l.square_size + roundf(10*k);
+	l.ind_button_h = roundf(60*k);
+	l.space_button_x = l.grad_square_x;
+	l.space_button_y = roundf(6*k);
+	l.space_button_w = roundf(84*k);
+	l.space_button_h = roundf(26*k);
+	l.pick_button_x = l.grad_square_x + l.square_size - l.space_button_w;
+	l.val_slider_x = l.ind_button_x + l.ind_button_h + roundf(20*k);
+	l.val_slider_y = l.ind_button_y;
+	l.val_slider_w = l.grad_square_x + l.square_size - l.val_slider_x;
+	l.val_slider_h = l.ind_button_h;
+	l.readout_pos = (Vector2) { l.grad_square_x, l.val_slider_y + roundf(70*k) };
+	l.readout_size = 30*k;
+	l.name_pos = (Vector2) { l.grad_square_x, l.readout_pos.y + roundf(36*k) };
+	l.name_size = 22*k;
+	l.contrast_pos = (Vector2) { l.space_button_x + l.space_button_w + roundf(10*k), l.space_button_y + roundf(4*k) };
+	l.contrast_size = 18*k;
+	l.history_x = l.grad_square_x;
+	l.history_y = l.name_pos.y + roundf(32*k);
+	l.swatch_size = roundf(28*k);
+	l.swatch_step = l.swatch_size + roundf(4*k);
+	l.swatches = (l.square_size + l.swatch_step - l.swatch_size) / l.swatch_step;
+	return l;
+}
+
+// The one mapping between slice values (0-255) and pixel offsets into the square,
+// used both to place the cursor and to pick.
+float value_to_offset(struct layout *l, int v)
+{
+	return (v + 0.5f) * l->square_size / 256;
+}
+
+int offset_to_value(struct layout *l, float offset)
+{
+	int v = floorf(offset * 256 / l->square_size);
+	return MIN(255, MAX(0, v));
+}
+
+// The slider knob's offset along the track; with --bits, of the full precision value.
+int slider_offset(struct state *st, struct layout *l)
+{
+	if (st->deep_bits) {
+		return roundf((float) l->val_slider_w*st->deep[CHANNEL_FIXED(st->which_fixed)] / (st->deep_steps - 1));
+	}
+	return roundf(l->val_slider_w * ( (float) st->fixed_value / 255 ));
+}
+
+void draw_axes(struct state *st, struct layout *l)
+{
+	int x0 = l->grad_square_x;
+	int y0 = l->grad_square_y;
+	int size = l->square_size;
+	float tick_sep = size / 8.;
+	int tick_width = MAX(1, roundf(2*l->scale));
+	int y_tick_len = l->y_axis_w/4;
+	int x_tick_len = l->x_axis_h/4;
+	Color tick_color = st->text_color;
+	float label_size = 22*l->scale;
+	Color label_color = st->text_color;
+
+	hud_draw_text(st->text_font, color_strings[st->space][CHANNEL_X(st->which_fixed)], 
+				  (Vector2) {x0 + size/2 - label_size, y0 - l->x_axis_h}, label_size, 2.*l->scale, label_color);
+	hud_draw_text(st->text_font, color_strings[st->space][CHANNEL_Y(st->which_fixed)], 
+				  (Vector2) {x0 - l->y_axis_w, y0 + size/2 - label_size}, label_size, 2.*l->scale, label_color);
+	// x axis
+	for (int i = 0; i < 8; i++) {
+		hud_draw_rect(x0 + roundf(i*tick_sep), y0-x_tick_len, tick_width, x_tick_len, tick_color);	
+	}
+	// perfectionist last tick
+	hud_draw_rect(x0+size-tick_width, y0-x_tick_len, tick_width, x_tick_len, tick_color);	
+	// y axis
+	for (int i = 0; i < 8; i++) {
+		hud_draw_rect(x0-y_tick_len, y0 + roundf(i*tick_sep), y_tick_len, tick_width, tick_color);	
+	}
+	hud_draw_rect(x0-y_tick_len, y0+size-tick_width, y_tick_len, tick_width, tick_color);	
+}
+
+// Everything that only depends on the window size, slice axis and text_color:
+// axes, space and indicator buttons and the slider track.
+void draw_chrome(struct state *st, struct layout *l)
+{
+	float k = l->scale;
+	text_begin(st);
+	draw_axes(st, l);
+	hud_draw_rect_lines((Rectangle) { l->ind_button_x, l->ind_button_y, l->ind_button_h, l->ind_button_h },
+						MAX(1, roundf(k)), st->text_color);
+	hud_draw_text(st->text_font, color_strings[st->space][st->which_fixed], (Vector2) {l->ind_button_x+18*k, l->ind_button_y+10*k},
+				  40.*k, 2*k, st->text_color);
+	hud_draw_rect_lines((Rectangle) { l->space_button_x, l->space_button_y, l->space_button_w, l->space_button_h },
+						MAX(1, roundf(k)), st->text_color);
+	Vector2 name_size = MeasureTextEx(st->text_font, space_names[st->space], 20.*k, 2*k);
+	hud_draw_text(st->text_font, space_names[st->space],
+				  (Vector2) {l->space_button_x + (l->space_button_w - name_size.x)/2, l->space_button_y+3*k},
+				  20.*k, 2*k, st->text_color);
+	hud_draw_rect_lines((Rectangle) { l->pick_button_x, l->space_button_y, l->space_button_w, l->space_button_h },
+						MAX(1, roundf(k)), st->text_color);
+	name_size = MeasureTextEx(st->text_font, "pick", 20.*k, 2*k);
+	hud_draw_text(st->text_font, "pick",
+				  (Vector2) {l->pick_button_x + (l->space_button_w - name_size.x)/2, l->space_button_y+3*k},
+				  20.*k, 2*k, st->text_color);
+	hud_draw_rect(l->val_slider_x, l->val_slider_y+roundf(26*k), l->val_slider_w, roundf(6*k), st->text_color);
+	text_end(st);
+}
+
+// A --panels panel draws in its own coordinates, moved into its part of the window
+// and clipped to it, so its ClearBackground only clears its own part.
+void panel_begin(struct state *st)
+{
+	if (!st->panel) {
+		return;
+	}
+	BeginScissorMode(st->panel_x, 0, st->screenWidth, st->screenHeight);
+	rlPushMatrix();
+	rlTranslatef(st->panel_x, 0, 0);
+}
+
+void panel_end(struct state *st)
+{
+	if (!st->panel) {
+		return;
+	}
+	rlPopMatrix();
+	EndScissorMode();
+}
+
+// Re-render the chrome layer into st->chrome if any of its inputs changed, then
+// composite it with a single draw.
+void draw_chrome_cached(struct state *st, struct layout *l)
+{
+	Color tc = st->text_color;
+	Color ctc = st->chrome_text_color;
+	if (!st->chrome_valid || st->chrome_w != st->screenWidth || st->chrome_h != st->screenHeight ||
+		st->chrome_axis != slice_axis(st) ||
+		tc.r != ctc.r || tc.g != ctc.g || tc.b != ctc.b || tc.a != ctc.a) {
+		if (st->chrome_w != st->screenWidth || st->chrome_h != st->screenHeight) {
+			if (st->chrome_valid) {
+				UnloadRenderTexture(st->chrome);
+			}
+			st->chrome = LoadRenderTexture(st->screenWidth, st->screenHeight);
+			st->chrome_w = st->screenWidth;
+			st->chrome_h = st->screenHeight;
+		}
+		st->chrome_axis = slice_axis(st);
+		st->chrome_text_color = st->text_color;
+		st->chrome_valid = true;
+
+		// the layer is in panel coordinates already, and EndTextureMode resets the
+		// transform anyway
+		panel_end(st);
+		BeginTextureMode(st->chrome);
+		ClearBackground(BLANK);
+		// Keep the layer premultiplied: plain alpha blending would also multiply the
+		// destination alpha by src alpha and thin out the antialiased text edges.
+		rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA,
+								  RL_FUNC_ADD, RL_FUNC_ADD);
+		BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+		draw_chrome(st, l);
+		EndBlendMode();
+		EndTextureMode();
+		panel_begin(st);
+	}
+	// render textures are stored upside down
+	BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+	hud_draw_texture_rec(st->chrome.texture, (Rectangle) { 0, 0, st->chrome_w, -st->chrome_h }, (Vector2) { 0, 0 }, WHITE);
+	EndBlendMode();
+}
+
+void draw_history(struct state *st, struct layout *l)
+{
+	int n = MIN(strip_count(st) - st->history.scroll, l->swatches);
+	for (int i = 0; i < n; i++) {
+		const struct history_record *r = strip_get(st, st->history.scroll + i);
+		hud_draw_rect(l->history_x + i*l->swatch_step, l->history_y, l->swatch_size, l->swatch_size,
+					  (Color) { r->r, r->g, r->b, 255 });
+	}
+}
+
+// Drops and screen samples come from outside the recorded input.
+static inline bool session_recorded(struct state *st)
+{
+	return st->record.f || st->replay.f;
+}
+
+// Take over the pointer and sample the screen under it until a click.
+void eyedropper_start(struct state *st)
+{
+	if (session_recorded(st)) {
+		TraceLog(LOG_WARNING, "CPICK: no eyedropper while recording or replaying");
+		return;
+	}
+	if (!capture_open(&st->capture)) {
+		return;
+	}
+	if (!st->mag_tex_loaded) {
+		Image img = GenImageColor(MAG_N, MAG_N, BLACK);
+		st->mag_tex = LoadTextureFromImage(img);
+		UnloadImage(img);
+		SetTextureFilter(st->mag_tex, TEXTURE_FILTER_POINT);
+		st->mag_tex_loaded = true;
+	}
+	st->eyedropper_saved = current_color(st);
+	st->eyedropper = true;
+}
+
+// keep: leave the sampled color picked, else go back to the one from before
+void eyedropper_stop(struct state *st, bool keep)
+{
+	capture_release(&st->capture);
+	st->eyedropper = false;
+	if (keep) {
+		history_add_current(st);
+	} else {
+		set_color(st, st->eyedropper_saved);
+	}
+}
+
+// Sample once per frame, while the eyedropper is on it owns all the input.
+void eyedropper_update(struct state *st)
+{
+	struct capture *c = &st->capture;
+	capture_sample(c);
+	UpdateTexture(st->mag_tex, c->pixels);
+	set_color(st, c->pixels[c->center_y*MAG_N + c->center_x]);
+	int click = capture_poll_click(c);
+	if (click) {
+		eyedropper_stop(st, click > 0);
+	} else if (input_key_pressed(&st->input, KEY_E)) {
+		eyedropper_stop(st, false);
+	}
+}
+
+// Zoomed view of the captured pixels, in the top right corner of the square.
+void draw_magnifier(struct state *st, struct layout *l)
+{
+	float k = l->scale;
+	int cell = roundf(8*k);
+	int size = MAG_N*cell;
+	int x = l->grad_square_x + l->square_size - size - roundf(10*k);
+	int y = l->grad_square_y + roundf(10*k);
+	int line = MAX(1, roundf(k));
+	hud_draw_texture_pro(st->mag_tex, (Rectangle) { 0, 0, MAG_N, MAG_N }, (Rectangle) { x, y, size, size },
+						 (Vector2) { 0, 0 }, 0., WHITE);
+	hud_draw_rect_lines((Rectangle) { x - line, y - line, size + 2*line, size + 2*line }, line, st->text_color);
+	hud_draw_rect_lines((Rectangle) { x + st->capture.center_x*cell, y + st->capture.center_y*cell, cell, cell },
+						line, st->text_color);
+}
+
+// Apply this frame's input to the state, before anything is drawn, so the frame
+// shows the result of the freshest pointer position rather than last frame's.
+void respond_input(struct state *st, struct layout *l)
+{
+	struct input *in = &st->input;
+	if (st->eyedropper) {
+		eyedropper_update(st);
+		input_consumed(in);
+		return;
+	}
+	if (st->deep_bits) {
+		deep_pull(st);
+	}
+	// the latest position with the button held, even if it has been released again
+	// since (a click shorter than a frame)
+	bool held = false;
+	Vector2 held_pos = in->pos;
+	for (int i = 0; i < in->nsamples; i++) {
+		if (in->samples[i].down) {
+			held = true;
+			held_pos = in->samples[i].pos;
+		}
+	}
+
+	// gradient square
+	int size = l->square_size;
+	Rectangle square = { l->grad_square_x, l->grad_square_y, size, size };
+	if (st->cube_view) {
+		cube_input(st, square, held, held_pos);
+	} else if (held && CheckCollisionPointRec(held_pos, square)) {
+		if (st->deep_bits) {
+			st->deep[CHANNEL_X(st->which_fixed)] = deep_from_offset(st, st->view_x, held_pos.x - l->grad_square_x, size);
+			st->deep[CHANNEL_Y(st->which_fixed)] = deep_from_offset(st, st->view_y, held_pos.y - l->grad_square_y, size);
+			deep_push(st);
+		} else {
+			st->x_value = offset_to_value(l, held_pos.x - l->grad_square_x);
+			st->y_value = offset_to_value(l, held_pos.y - l->grad_square_y);
+		}
+		st->square_held = true;
+	}
+	if (st->deep_bits && !st->cube_view && in->wheel != 0 && CheckCollisionPointRec(in->pos, square)) {
+		deep_zoom(st, in->wheel, (Vector2) { in->pos.x - l->grad_square_x, in->pos.y - l->grad_square_y }, size);
+	}
+	if (st->square_held && !in->down) {
+		history_add_current(st);
+		st->square_held = false;
+	}
+
+	// history strip: the wheel scrolls back in time, a click goes back to a swatch
+	Rectangle strip = { l->history_x, l->history_y, l->swatches*l->swatch_step, l->swatch_size };
+	int nstrip = strip_count(st);
+	if (in->wheel != 0 && CheckCollisionPointRec(in->pos, strip)) {
+		st->history.scroll += in->wheel > 0 ? 1 : -1;
+		st->history.scroll = MAX(0, MIN(nstrip - l->swatches, st->history.scroll));
+	}
+	if (in->pressed && CheckCollisionPointRec(in->press_pos, strip)) {
+		int i = st->history.scroll + (int) (in->press_pos.x - l->history_x) / l->swatch_step;
+		if (i < nstrip) {
+			history_restore(st, strip_get(st, i));
+			if (i < st->nextracted) {
+				// picking an extracted color is what puts it in the history
+				history_add_current(st);
+			}
+		}
+	}
+
+	// indicator button 
+	if (in->pressed) {
+		Vector2 pos = in->press_pos;
+		if (CheckCollisionPointRec(pos, (Rectangle) { l->ind_button_x, l->ind_button_y, l->ind_button_h, l->ind_button_h})) {
+			st->which_fixed = (st->which_fixed + 1) % 3;
+			// Preserve color: x becomes the new fixed, y the new x, fixed the new y
+			int tmp = st->fixed_value;
+			st->fixed_value = st->x_value;
+			st->x_value = st->y_value;
+			st->y_value = tmp;
+		}
+		if (CheckCollisionPointRec(pos, (Rectangle) { l->space_button_x, l->space_button_y, l->space_button_w, l->space_button_h })) {
+			set_space(st, (st->space + 1) % SPACE_COUNT);
+		}
+		if (CheckCollisionPointRec(pos, (Rectangle) { l->pick_button_x, l->space_button_y, l->space_button_w, l->space_button_h })) {
+			eyedropper_start(st);
+		}
+	}
+
+	// fixed value slider 
+	int val_slider_x = l->val_slider_x;
+	int val_slider_w = l->val_slider_w;
+	int val_slider_offset = slider_offset(st, l);
+	Vector2 circle_center = { val_slider_x + val_slider_offset, l->val_slider_y+30*l->scale };
+	if (held) {
+		TraceLog(LOG_DEBUG, "Received click. dragging: %d", st->val_slider_dragging);
+		Vector2 pos = held_pos;
+		// only a hit on the knob or track moves it: going back through the pixel
+		// offset would round away the full precision value, or with a track under
+		// 255px, 8-bit values
+		bool hit = false;
+		if (CheckCollisionPointCircle(pos, circle_center, 30*l->scale) || st->val_slider_dragging) {
+			st->val_slider_dragging = true;
+			val_slider_offset = MIN(val_slider_w, MAX(0, pos.x - val_slider_x));
+			hit = true;
+		} else if (CheckCollisionPointRec(pos, (Rectangle) { val_slider_x, l->val_slider_y, val_slider_w, l->val_slider_h } )) {
+			val_slider_offset = pos.x - val_slider_x;
+			hit = true;
+		}
+		if (hit && st->deep_bits) {
+			st->deep[CHANNEL_FIXED(st->which_fixed)] = roundf((float) (st->deep_steps - 1)*val_slider_offset / val_slider_w);
+			deep_push(st);
+		} else if (hit) {
+			st->fixed_value = roundf((float) 255*val_slider_offset / val_slider_w);
+		}
+	}
+	if (!in->down) {
+		st->val_slider_dragging = false;
+	}
+
+	if (input_key_pressed(in, KEY_E) && !st->eyedropper) {
+		eyedropper_start(st);
+	}
+	if ((!st->panel || st->focused) && IsFileDropped()) {
+		FilePathList files = LoadDroppedFiles();
+		if (session_recorded(st)) {
+			TraceLog(LOG_WARNING, "CPICK: dropped files are ignored while recording or replaying");
+		}
+		for (unsigned int i = 0; i < files.count && !session_recorded(st); i++) {
+			Image img = LoadImage(files.paths[i]);
+			if (IsImageReady(img)) {
+				extract_to_strip(st, img, st->extract_k);
+			} else {
+				TraceLog(LOG_WARNING, "CPICK: can't load %s as an image", files.paths[i]);
+			}
+			UnloadImage(img);
+		}
+		UnloadDroppedFiles(files);
+	}
+	if (input_key_pressed(in, KEY_V)) {
+		if (st->cube_shader.id) {
+			st->cube_view = !st->cube_view;
+		} else {
+			TraceLog(LOG_WARNING, "CPICK: the cube view needs the shader renderer");
+		}
+	}
+	if (input_key_pressed(in, KEY_F3)) {
+		st->hud.visible = !st->hud.visible;
+	}
+	if (input_key_pressed(in, KEY_C)) {
+		// the color the overlay is turned on at is what the slice is compared to
+		if (!st->contrast_level) {
+			st->contrast_ref = current_color(st);
+		}
+		st->contrast_level = (st->contrast_level + 1) % CONTRAST_LEVELS;
+	}
+	if (input_key_pressed(in, KEY_ENTER)) {
+		history_add_current(st);
+		st->accepted = true;
+	}
+	if (st->deep_bits) {
+		// the slider is a few hundred pixels for up to 65536 steps: the arrow keys
+		// step the fixed component one at a time
+		int *f = &st->deep[CHANNEL_FIXED(st->which_fixed)];
+		int step = input_key_pressed(in, KEY_RIGHT) - input_key_pressed(in, KEY_LEFT);
+		if (step) {
+			*f = MIN(st->deep_steps - 1, MAX(0, *f + step));
+			deep_push(st);
+		}
+		deep_pull(st);
+		if (slice_axis(st) != st->view_axis) {
+			st->view_x = st->view_y = 0;
+			st->view_span = 1;
+			st->view_axis = slice_axis(st);
+		}
+	}
+	input_consumed(in);
+}
+
+void draw_ui_and_respond_input(struct state *st)
+{
+	struct layout l = get_layout(st);
+	respond_input(st, &l);
+	hud_mark(&st->hud, STAGE_INPUT);
+
+	ClearBackground( current_color(st) );
+	Color cur_color = current_color(st);
+	// whichever of black and white has more contrast on the background
+	float y = relative_luminance(cur_color);
+	st->text_color = contrast_ratio(y, 0) > contrast_ratio(y, 1) ? BLACK : WHITE;
+	draw_chrome_cached(st, &l);
+	hud_mark(&st->hud, STAGE_AXES);
 
-Color current_color(struct state *st) 
+	// gradient square
+	int grad_square_x = l.grad_square_x;
+	int grad_square_y = l.grad_square_y;
+	int size = l.square_size;
+	if (st->cube_view) {
+		draw_cube(grad_square_x, grad_square_y, size, st);
+	} else if (st->deep_bits) {
+		draw_gradient_deep(grad_square_x, grad_square_y, size, st);
+	} else if (st->renderer == RENDER_SHADER) {
+		draw_gradient_shader(grad_square_x, grad_square_y, size, size, st);
+	} else {
+		draw_gradient_cached(grad_square_x, grad_square_y, size, st);
+	}
+	hud_mark(&st->hud, STAGE_GRADIENT);
+	int cur_loc_sq_sz = MAX(2, roundf(4*l.scale));
+	float cur_x = value_to_offset(&l, st->x_value), cur_y = value_to_offset(&l, st->y_value);
+	if (st->deep_bits) {
+		cur_x = deep_to_offset(st, st->view_x, st->deep[CHANNEL_X(st->which_fixed)], size);
+		cur_y = deep_to_offset(st, st->view_y, st->deep[CHANNEL_Y(st->which_fixed)], size);
+	}
+	if (!st->cube_view && cur_x >= 0 && cur_x < size && cur_y >= 0 && cur_y < size) {
+		hud_draw_rect(grad_square_x + cur_x - cur_loc_sq_sz/2, grad_square_y + cur_y - cur_loc_sq_sz/2,
+					  cur_loc_sq_sz, cur_loc_sq_sz, st->text_color);
+	}
+	if (st->eyedropper) {
+		draw_magnifier(st, &l);
+	}
+	hud_mark(&st->hud, STAGE_CURSOR);
+
+	// fixed value slider 
+	int wf = st->which_fixed;
+	int val_slider_offset = slider_offset(st, &l);
+	Vector2 circle_center = { l.val_slider_x + val_slider_offset, l.val_slider_y+30*l.scale };
+	Color knob = { wf == 0 ? 218 : 0, wf == 1 ? 216 : 0,  wf == 2 ? 216 : 0, 255 };
+	if (st->space != SPACE_RGB) {
+		knob = (Color) { 216, 216, 216, 255 };
+	}
+	hud_draw_circle(circle_center, 15*l.scale, knob);
+	hud_mark(&st->hud, STAGE_SLIDER);
+
+	// color read out
+	text_begin(st);
+	draw_readout(st, cur_color, l.readout_pos, l.readout_size);
+	draw_color_name(st, cur_color, l.name_pos, l.name_size);
+	draw_contrast_status(st, cur_color, l.contrast_pos, l.contrast_size);
+	text_end(st);
+	hud_mark(&st->hud, STAGE_READOUT);
+
+	draw_history(st, &l);
+	hud_mark(&st->hud, STAGE_HISTORY);
+}
+
+// Everything the renderer needs once a window (and GL context) exists.
+void load_render_resources(struct state *st, bool force_cpu)
 {
-	int v1 = st->fixed_value;
-	int v2 = st->x_value;
-	int v3 = st->y_value;
-	switch (st->which_fixed) {
-		case 0:
-			return (Color) { v1, v2, v3, 255 };
-			break;
-		case 1:
-			return (Color) { v3, v1, v2, 255 };
-			break;
-		case 2:
-			return (Color) { v2, v3, v1, 255 };
-			break;
+	init_fill_slice();
+	thread_pool_init(&workers, 0);
+	if (!force_cpu && load_gradient_shader(st)) {
+		st->renderer = RENDER_SHADER;
+		Image slice_img = GenImageColor(256, 256, BLACK);
+		st->slice_tex = LoadTextureFromImage(slice_img);
+		UnloadImage(slice_img);
+		Image gamut_img = { gamut_atlas, GAMUT_ATLAS_W, GAMUT_ATLAS_W, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+		st->gamut_tex = LoadTextureFromImage(gamut_img);
+		SetTextureFilter(st->gamut_tex, TEXTURE_FILTER_BILINEAR);
+		load_cube_shader(st);
+	} else {
+		st->renderer = RENDER_CPU;
+		st->slices = &st->slice_cache;
+		slice_pool_init(st->slices);
 	}
+	if (st->deep_bits) {
+		deep_tiles_init(&st->tiles, st->deep_bits);
+	}
+	load_text_shader(st);
 }
 
-void draw_gradient_n(int x, int y, int n, int which_fixed, int fixed_val)  
+// --panels: the panels after the first draw with its font, shaders and slice cache
+// instead of loading their own.
+void share_render_resources(struct state *st, const struct state *owner)
 {
-	int cur_x = x;
-	int cur_y = y;
-	for (int v2 = 0; v2 < 256; v2++) {
-		for (int v1 = 0; v1 < 256; v1++) {
-			struct Color col;
-			if (which_fixed == 0) { // red
-				col =  (Color) { fixed_val, v1, v2, 255 };
-			} else if (which_fixed == 1) { // green
-				col = (Color) { v2, fixed_val, v1, 255 };
-			} else if (which_fixed == 2) { // blue
-				col = (Color) { v1, v2, fixed_val, 255 };
+	st->text_font = owner->text_font;
+	st->text_shader = owner->text_shader;
+	st->text_sdf = owner->text_sdf;
+	st->renderer = owner->renderer;
+	st->slices = owner->slices;
+	st->slice_tex = owner->slice_tex;
+	st->gradient_shader = owner->gradient_shader;
+	st->which_fixed_loc = owner->which_fixed_loc;
+	st->space_loc = owner->space_loc;
+	st->gamut_lut_loc = owner->gamut_lut_loc;
+	st->gamut_tex = owner->gamut_tex;
+	st->contrast_min_loc = owner->contrast_min_loc;
+	st->contrast_ref_loc = owner->contrast_ref_loc;
+	st->fixed_value_loc = owner->fixed_value_loc;
+	st->cube_shader = owner->cube_shader;
+	memcpy(st->cube_locs, owner->cube_locs, sizeof(st->cube_locs));
+	st->cube_yaw = owner->cube_yaw;
+	st->cube_pitch = owner->cube_pitch;
+	st->cube_dist = owner->cube_dist;
+	if (st->deep_bits) {
+		// the view, and so the tiles in it, is the panel's own
+		deep_tiles_init(&st->tiles, st->deep_bits);
+	}
+}
+
+// What a panel has of its own: its deep tiles, eyedropper and chrome layer.
+void unload_panel_resources(struct state *st)
+{
+	deep_tiles_free(&st->tiles);
+	capture_close(&st->capture);
+	if (st->mag_tex_loaded) {
+		UnloadTexture(st->mag_tex);
+		st->mag_tex_loaded = false;
+	}
+	if (st->chrome_valid) {
+		UnloadRenderTexture(st->chrome);
+		st->chrome_valid = false;
+	}
+}
+
+void unload_render_resources(struct state *st)
+{
+	if (st->renderer == RENDER_SHADER) {
+		UnloadShader(st->gradient_shader);
+		UnloadTexture(st->slice_tex);
+		UnloadTexture(st->gamut_tex);
+		if (st->cube_shader.id) {
+			UnloadShader(st->cube_shader);
+		}
+	} else {
+		slice_pool_free(st->slices);
+	}
+	thread_pool_free(&workers);
+	if (st->text_sdf) {
+		UnloadShader(st->text_shader);
+		st->text_sdf = false;
+	}
+	unload_panel_resources(st);
+}
+
+/*
+ * --convert: one color per line from stdin in format from, answered on stdout
+ * with its conversion to each of the formats in to, tab separated. Both sides go
+ * through large blocks; lines that don't parse come out as "invalid" so the
+ * output stays line for line with the input.
+ */
+#define CONVERT_BLOCK (1 << 20)
+#define CONVERT_MAX_TO 16
+
+int format_index(const char *name, size_t len)
+{
+	for (int i = 0; i < FMT_COUNT; i++) {
+		if (strlen(format_names[i]) == len && !strncasecmp(name, format_names[i], len)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Returns the exit status.
+int convert_stream(FILE *in, FILE *out, int from, const int *to, int nto)
+{
+	char *ibuf = (char *) malloc(CONVERT_BLOCK);
+	char *obuf = (char *) malloc(CONVERT_BLOCK);
+	size_t have = 0; // bytes at the start of ibuf not consumed yet
+	size_t olen = 0;
+	long invalid = 0;
+	bool eof = false;
+	bool skipping = false; // in the rest of a line too long for the buffer
+	for (;;) {
+		if (!eof) {
+			size_t n = fread(ibuf + have, 1, CONVERT_BLOCK - have, in);
+			have += n;
+			eof = n == 0 && have < CONVERT_BLOCK;
+		}
+		char *p = ibuf, *end = ibuf + have, *nl;
+		if (skipping) {
+			nl = (char *) memchr(p, '\n', end - p);
+			p = nl ? nl + 1 : end;
+			skipping = !nl;
+		}
+		// whole lines, plus the unterminated last one at EOF, plus a line too long
+		// for the buffer
+		while ((nl = (char *) memchr(p, '\n', end - p)) || (eof && p < end) ||
+			   (p == ibuf && have == CONVERT_BLOCK)) {
+			char *line_end = nl ? nl : end;
+			char *next = nl ? nl + 1 : end;
+			while (line_end > p && (line_end[-1] == '\r' || line_end[-1] == ' ')) {
+				line_end--;
 			}
-			for (int iy = 0; iy < n; iy++) {
-				for (int ix = 0; ix < n; ix++) {
-					DrawPixel(cur_x + ix, cur_y + iy, col);  
+			if (olen > CONVERT_BLOCK - 64*CONVERT_MAX_TO) {
+				fwrite(obuf, 1, olen, out);
+				olen = 0;
+			}
+			char *o = obuf + olen;
+			Color c;
+			if (!nl && !eof) {
+				// longer than the buffer: not a color, and one answer for all of it
+				o = put_str(o, "invalid");
+				invalid++;
+				skipping = true;
+			} else if (line_end == p) {
+				// blank in, blank out
+			} else if (parse_color(from, p, line_end, &c)) {
+				for (int i = 0; i < nto; i++) {
+					if (i) {
+						*o++ = '\t';
+					}
+					o = put_color(o, to[i], c);
 				}
+			} else {
+				o = put_str(o, "invalid");
+				invalid++;
 			}
-			cur_x += n;
+			*o++ = '\n';
+			olen = o - obuf;
+			p = next;
+		}
+		have = end - p;
+		memmove(ibuf, p, have);
+		if (eof && !have) {
+			break;
 		}
-		cur_x = x;
-		cur_y += n;
 	}
+	fwrite(obuf, 1, olen, out);
+	fflush(out);
+	free(ibuf);
+	free(obuf);
+	if (invalid) {
+		fprintf(stderr, "cpick: %ld invalid %s lines\n", invalid, format_names[from]);
+		return 1;
+	}
+	return 0;
 }
 
-// TODO: parameter for 512 vs etc ? 
-void draw_axes(int x, int y, int w, int h, struct state *st)
+int convert(const char *from_name, const char *to_list)
 {
-	int tick_sep = 64;
-	int tick_width = 2; 
-	int y_tick_len = w/4;
-	int x_tick_len = h/4;
-	Color tick_color = st->text_color;
-	int label_size = 22;
-	Color label_color = st->text_color;
+	int from = format_index(from_name, strlen(from_name));
+	if (from < 0) {
+		fprintf(stderr, "cpick: unknown format %s\n", from_name);
+		return 1;
+	}
+	int to[CONVERT_MAX_TO], nto = 0;
+	for (const char *p = to_list; *p; ) {
+		size_t len = strcspn(p, ",");
+		int f = format_index(p, len);
+		if (f < 0 || nto == CONVERT_MAX_TO) {
+			fprintf(stderr, "cpick: bad --to list %s\n", to_list);
+			return 1;
+		}
+		to[nto++] = f;
+		p += len + (p[len] == ',');
+	}
+	init_formats();
+	init_hue_lut();
+	init_ok_tables();
+	return convert_stream(stdin, stdout, from, to, nto);
+}
 
-	DrawTextEx(st->text_font, color_strings[(st->which_fixed+1)%3], 
-			   (Vector2) {x+w + 512/2 - label_size, y}, label_size, 2., label_color);
-	DrawTextEx(st->text_font, color_strings[(st->which_fixed+2)%3], 
-			   (Vector2) {x, y+h + 512/2 - label_size}, label_size, 2., label_color);
-	// x axis
-	for (int ix = x+w; ix < (x+w+512); ix += tick_sep) {
-		DrawRectangle(ix, y+h-x_tick_len, tick_width, x_tick_len, tick_color);	
+// --export-slices: every slice along one axis, written as 256x256 PNGs without a
+// window. Slices are spread over the worker pool; each band fills a slice into its
+// own buffer, encodes it, and reuses the buffer for the next.
+//
+// The PNG is put together here around raylib's CompressData rather than written
+// with ExportImage, whose file extension check goes through TextSplit and
+// TextToLower and so shares their static buffers between the threads.
+uint32_t png_crc_table[256];
+
+void init_png_crc(void)
+{
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++) {
+			c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		}
+		png_crc_table[n] = c;
 	}
-	// perfectionist last tick
-	DrawRectangle(x+w+512-tick_width, y+h-x_tick_len, tick_width, x_tick_len, tick_color);	
-	// y axis
-	for (int iy = y+h; iy < (y+h+512); iy += tick_sep) {
-		DrawRectangle(x+w-y_tick_len, iy, y_tick_len, tick_width, tick_color);	
+}
+
+void put_be32(unsigned char *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+uint32_t png_crc(uint32_t crc, const unsigned char *p, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		crc = png_crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
 	}
-	DrawRectangle(x+w-y_tick_len, y+h+512-tick_width, y_tick_len, tick_width, tick_color);	
+	return crc;
 }
 
-void draw_ui_and_respond_input(struct state *st)
+// Length, type, data, then the CRC of type and data.
+bool write_png_chunk(FILE *f, const char *type, const unsigned char *data, uint32_t n)
 {
-	ClearBackground( current_color(st) );
-	Color cur_color = current_color(st);
-	if (cur_color.r*cur_color.r + cur_color.g*cur_color.g + cur_color.b*cur_color.b > 110000) {
-		st->text_color = BLACK;
-	} else {
-		st->text_color = WHITE;
+	unsigned char head[8], crc[4];
+	put_be32(head, n);
+	memcpy(head + 4, type, 4);
+	put_be32(crc, png_crc(png_crc(0xffffffffu, head + 4, 4), data, n) ^ 0xffffffffu);
+	return fwrite(head, 1, 8, f) == 8 && fwrite(data, 1, n, f) == n && fwrite(crc, 1, 4, f) == 4;
+}
+
+// 8-bit RGBA, no row filters.
+bool write_png(const char *path, const Color *pixels, int w, int h)
+{
+	int stride = 4*w + 1, size = stride*h;
+	unsigned char *raw = (unsigned char *) malloc(size);
+	for (int y = 0; y < h; y++) {
+		raw[y*stride] = 0;
+		memcpy(raw + y*stride + 1, pixels + y*w, 4*w);
+	}
+	uint32_t a = 1, b = 0; // adler32, for the zlib trailer
+	for (int i = 0; i < size; i++) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	int n = 0;
+	unsigned char *deflated = CompressData(raw, size, &n);
+	free(raw);
+	if (!deflated) {
+		return false;
+	}
+	// CompressData gives a raw deflate stream; IDAT wants it in a zlib wrapper
+	unsigned char *idat = (unsigned char *) malloc(n + 6);
+	idat[0] = 0x78;
+	idat[1] = 0x01;
+	memcpy(idat + 2, deflated, n);
+	put_be32(idat + 2 + n, b << 16 | a);
+	MemFree(deflated);
+	unsigned char ihdr[13] = { 0 };
+	put_be32(ihdr, w);
+	put_be32(ihdr + 4, h);
+	ihdr[8] = 8; // bit depth
+	ihdr[9] = 6; // RGBA
+	FILE *f = fopen(path, "wb");
+	bool ok = f && fwrite("\x89PNG\r\n\x1a\n", 1, 8, f) == 8 &&
+		write_png_chunk(f, "IHDR", ihdr, sizeof(ihdr)) &&
+		write_png_chunk(f, "IDAT", idat, n + 6) &&
+		write_png_chunk(f, "IEND", ihdr, 0);
+	if (f && fclose(f)) {
+		ok = false;
 	}
+	free(idat);
+	return ok;
+}
 
-	// gradient square
-	int y_axis_w = 30;
-	int x_axis_h = 30; 
-	int grad_square_w = 512 + y_axis_w;
-	int grad_square_h = 512 + x_axis_h;
-	int grad_square_x = (st->screenWidth - 512)/2;
-	int grad_square_y = 40;
-	int grad_square_y_end = grad_square_y + 512;
-	int grad_square_x_end = grad_square_x + 512;
-	draw_axes(grad_square_x-y_axis_w, grad_square_y-x_axis_h, x_axis_h, y_axis_w, st);
-	draw_gradient_n(grad_square_x, grad_square_y, 512/256, st->which_fixed, st->fixed_value);
-	int cur_loc_sq_sz = 4;
-	// depends on 512...
-	int square_x_offset = st->x_value * 2;
-	int square_y_offset = st->y_value * 2;
-	DrawRectangle(grad_square_x + square_x_offset - cur_loc_sq_sz/2,
-			grad_square_y + square_y_offset - cur_loc_sq_sz/2,
-			cur_loc_sq_sz, cur_loc_sq_sz, st->text_color);
-	if (IsMouseButtonDown(0)) {
-		Vector2 pos = GetMousePosition();
-		if (CheckCollisionPointRec(pos, (Rectangle) { grad_square_x, grad_square_y, 512, 512 })) {
-			// depends on 512...
-			st->x_value = (pos.x - grad_square_x) / 2;
-			st->y_value = (pos.y - grad_square_y) / 2;
+struct export_job {
+	int axis;
+	const char *dir;
+	const char *space;
+	const char *component;
+	int failed;
+};
+
+void export_band(void *ctx, int v0, int v1)
+{
+	struct export_job *job = ctx;
+	Color *pixels = (Color *) malloc(256*256*sizeof(Color));
+	char path[4096];
+	for (int v = v0; v < v1; v++) {
+		fill_slice_axis(pixels, job->axis, v, 0, 256);
+		snprintf(path, sizeof(path), "%s/%s_%s_%03d.png", job->dir, job->space, job->component, v);
+		if (!write_png(path, pixels, 256, 256)) {
+			__atomic_add_fetch(&job->failed, 1, __ATOMIC_RELAXED);
 		}
 	}
+	free(pixels);
+}
 
-	// indicator button 
-	int ind_button_x = grad_square_x;
-	int ind_button_y = grad_square_y_end + 10;
-	int ind_button_h = 60;
-	DrawRectangleLines(ind_button_x, ind_button_y, ind_button_h, ind_button_h, st->text_color);
-	DrawTextEx(st->text_font, color_strings[st->which_fixed], (Vector2) {ind_button_x+18, ind_button_y+10}, 40., 2, st->text_color);
-	// DrawTextEx(st->text_font, value, (Vector2) {grad_square_x, val_slider_y + 70}, 30., 1.5, st->text_color);
-	if (IsMouseButtonPressed(0)) {
-		Vector2 pos = GetMousePosition();
-		if (CheckCollisionPointRec(pos, (Rectangle) { ind_button_x, ind_button_y, ind_button_h, ind_button_h})) {
-			st->which_fixed = (st->which_fixed + 1) % 3;
-			// Preserve color: x becomes the new fixed, y the new x, fixed the new y
-			int tmp = st->fixed_value;
-			st->fixed_value = st->x_value;
-			st->x_value = st->y_value;
-			st->y_value = tmp;
+// Returns the exit status.
+int export_slices(const char *space_name, const char *component, const char *dir)
+{
+	int space = -1, which_fixed = -1;
+	for (int i = 0; i < SPACE_COUNT; i++) {
+		if (!strcasecmp(space_name, space_names[i])) {
+			space = i;
+		}
+	}
+	if (space < 0) {
+		fprintf(stderr, "cpick: unknown color space %s\n", space_name);
+		return 1;
+	}
+	for (int i = 0; i < 3; i++) {
+		if (!strcasecmp(component, color_strings[space][i])) {
+			which_fixed = i;
 		}
 	}
+	if (which_fixed < 0) {
+		fprintf(stderr, "cpick: %s has no component %s\n", space_names[space], component);
+		return 1;
+	}
+	if (mkdir(dir, 0755) && errno != EEXIST) {
+		perror(dir);
+		return 1;
+	}
+	SetTraceLogLevel(LOG_WARNING);
+	init_fill_slice();
+	init_png_crc();
+	thread_pool_init(&workers, 0);
+	struct export_job job = { 3*space + which_fixed, dir, space_names[space], color_strings[space][which_fixed], 0 };
+	parallel_for(&workers, 256, 1, export_band, &job);
+	thread_pool_free(&workers);
+	if (job.failed) {
+		fprintf(stderr, "cpick: %d slices could not be written to %s\n", job.failed, dir);
+		return 1;
+	}
+	return 0;
+}
 
-	// fixed value slider 
-	int val_slider_x = ind_button_x + ind_button_h + 20;
-	int val_slider_y = ind_button_y;
-	int val_slider_w = grad_square_x_end - val_slider_x;
-	int val_slider_h = 60;
-	DrawRectangle(val_slider_x, val_slider_y+26, val_slider_w, 6, st->text_color);
-	int wf = st->which_fixed;
-	int val_slider_offset = roundf(val_slider_w * ( (float) st->fixed_value / 255 ));
-	Vector2 circle_center = { val_slider_x + val_slider_offset, val_slider_y+30 };
-	DrawCircleV(circle_center, 15,
-			   (Color) { wf == 0 ? 218 : 0, wf == 1 ? 216 : 0,  wf == 2 ? 216 : 0, 255 });
-	if (IsMouseButtonDown(0)) {
-		TraceLog(LOG_DEBUG, "Received click. dragging: %d", st->val_slider_dragging);
-		Vector2 pos = GetMousePosition();
-		if (CheckCollisionPointCircle(pos, circle_center, 30) || st->val_slider_dragging) {
-			st->val_slider_dragging = true;
-			val_slider_offset = MIN(val_slider_w, MAX(0, pos.x - val_slider_x));
-		} else if (CheckCollisionPointRec(pos, (Rectangle) { val_slider_x, val_slider_y, val_slider_w, val_slider_w } )) {
-			val_slider_offset = pos.x - val_slider_x;
+bool record_open(struct recording *r, const char *path, int deep_bits)
+{
+	r->f = fopen(path, "wb");
+	if (!r->f) {
+		fprintf(stderr, "cpick: can't write %s\n", path);
+		return false;
+	}
+	struct recording_header h = { .frame_size = sizeof(struct recording_frame), .deep_bits = deep_bits };
+	memcpy(h.magic, RECORDING_MAGIC, 8);
+	fwrite(&h, sizeof(h), 1, r->f);
+	r->origin = now_seconds();
+	return true;
+}
+
+void record_frame(struct recording *r, struct state *st)
+{
+	struct recording_frame f;
+	memset(&f, 0, sizeof(f)); // no stray padding bytes in the file
+	f.t = now_seconds() - r->origin;
+	f.width = st->screenWidth;
+	f.height = st->screenHeight;
+	f.input = st->input;
+	input_shift(&f.input, -r->origin);
+	fwrite(&f, sizeof(f), 1, r->f);
+}
+
+// Sets *deep_bits to the recording's, since the same input means something else
+// at another bit depth.
+bool replay_open(struct recording *r, const char *path, bool fast, int *deep_bits)
+{
+	struct recording_header h;
+	r->f = fopen(path, "rb");
+	if (!r->f) {
+		fprintf(stderr, "cpick: can't open recording %s\n", path);
+		return false;
+	}
+	if (fread(&h, sizeof(h), 1, r->f) != 1 || memcmp(h.magic, RECORDING_MAGIC, 8) ||
+		h.frame_size != sizeof(struct recording_frame)) {
+		fprintf(stderr, "cpick: %s isn't a recording from this version of cpick\n", path);
+		fclose(r->f);
+		r->f = NULL;
+		return false;
+	}
+	if (h.deep_bits != 0 && h.deep_bits != 10 && h.deep_bits != 12 && h.deep_bits != 16) {
+		fprintf(stderr, "cpick: %s has a bad bit depth\n", path);
+		fclose(r->f);
+		r->f = NULL;
+		return false;
+	}
+	*deep_bits = h.deep_bits;
+	r->fast = fast;
+	return true;
+}
+
+// The next frame's input and window size, in place of polling; false at the end.
+bool replay_frame(struct recording *r, struct state *st)
+{
+	struct recording_frame f;
+	if (fread(&f, sizeof(f), 1, r->f) != 1) {
+		r->done = true;
+		return false;
+	}
+	if (r->n == 0) {
+		r->origin = now_seconds() - f.t; // the first frame is now, not after startup
+	}
+	if (!r->fast) {
+		double wait = r->origin + f.t - now_seconds();
+		if (wait > 0) {
+			WaitTime(wait);
+		}
+	}
+	// as if the samples had just been taken
+	st->input = f.input;
+	input_shift(&st->input, now_seconds() - f.t);
+	if (f.width != GetScreenWidth() || f.height != GetScreenHeight()) {
+		SetWindowSize(f.width, f.height);
+	}
+	st->screenWidth = f.width;
+	st->screenHeight = f.height;
+	return true;
+}
+
+int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+void replay_report(struct recording *r, struct state *st, const char *path)
+{
+	double *sorted = malloc(MAX(1, r->n)*sizeof(double));
+	memcpy(sorted, r->frame_t, r->n*sizeof(double));
+	qsort(sorted, r->n, sizeof(double), cmp_double);
+	#define PCT(p) (r->n ? sorted[(int) ((r->n - 1)*(p) + 0.5)]*1000 : 0)
+	printf("replay %s: %d frames, %s\n", path, r->n, r->fast ? "fast" : "real time");
+	printf("frame_ms p50 %.3f p90 %.3f p99 %.3f max %.3f\n", PCT(0.5), PCT(0.9), PCT(0.99), PCT(1));
+	#undef PCT
+	char picked[64];
+	format_picked(st, picked, sizeof(picked));
+	printf("state space %s which_fixed %d fixed_value %d x_value %d y_value %d color %s\n",
+		   space_names[st->space], st->which_fixed, st->fixed_value, st->x_value, st->y_value, picked);
+	printf("state contrast_level %d cube_view %d accepted %d", st->contrast_level, st->cube_view, st->accepted);
+	if (st->deep_bits) {
+		printf(" deep %d %d %d", st->deep[0], st->deep[1], st->deep[2]);
+	}
+	printf("\nframes\n");
+	for (int i = 0; i < r->n; i++) {
+		printf("%.3f\n", r->frame_t[i]*1000);
+	}
+	free(sorted);
+}
+
+// One frame of the picker: input, drawing, and the swap.
+void run_frame(struct state *st)
+{
+	if (st->replay.f) {
+		if (!replay_frame(&st->replay, st)) {
+			return;
 		}
-		st->fixed_value = roundf((float) 255*val_slider_offset / val_slider_w);
 	} else {
-		st->val_slider_dragging = false;
+		pacing_wait();
+		// Pick up whatever arrived since EndDrawing's poll, right before drawing.
+		input_poll(&st->input);
+		st->screenWidth = GetScreenWidth();
+		st->screenHeight = GetScreenHeight();
+	}
+	if (st->record.f) {
+		record_frame(&st->record, st);
+	}
+	double frame_start = now_seconds();
+	double input_t = st->input.t;
+	// the eyedropper samples the screen every frame
+	bool held = st->input.down || st->eyedropper;
+	if (st->low_latency && held != st->uncapped) {
+		// don't let the vsync wait hold back a drag
+		set_vsync(!held);
+		st->uncapped = held;
+	}
+	// Draw
+	hud_begin_frame(&st->hud);
+	BeginDrawing();
+	draw_ui_and_respond_input(st);
+	hud_count_draw_calls(&st->hud);
+	if (st->hud.visible) {
+		draw_hud(st);
+	}
+	// Idle mode: sleep in EndDrawing until the next input/resize event, except
+	// while the mouse is held, where drags need a fresh frame every tick, and
+	// once Enter has ended the pick.
+	bool idle = !st->continuous && !held && !st->accepted;
+	if (idle) {
+		EnableEventWaiting();
+	}
+	st->hud.mark = now_seconds(); // the HUD doesn't count against any stage
+	double swap = st->hud.mark;
+	EndDrawing();
+	if (st->replay.f) {
+		struct recording *r = &st->replay;
+		if (r->n == r->cap) {
+			r->cap = r->cap ? 2*r->cap : 1024;
+			r->frame_t = realloc(r->frame_t, r->cap*sizeof(double));
+		}
+		r->frame_t[r->n++] = now_seconds() - frame_start;
+	} else {
+		pacing_frame_done(frame_start, swap, now_seconds(),
+						  idle ? PACE_IDLE : st->uncapped ? PACE_UNCAPPED : PACE_PACED);
+		input_collect(&st->input);
 	}
+	hud_mark(&st->hud, STAGE_SWAP);
+	hud_end_frame(&st->hud, input_t, idle);
+}
 
-	// color read out
-	char value[30];
-	sprintf(value, "r:%-3d g:%-3d b:%-3d hex:#%02x%02x%02x", cur_color.r, cur_color.g, cur_color.b, cur_color.r, cur_color.g, cur_color.b);
-	DrawTextEx(st->text_font, value, (Vector2) {grad_square_x, val_slider_y + 70}, 30., 1.5, st->text_color);
+/*
+ * --panels N: N pickers side by side in one window, each with its own state, to
+ * compare colors or build a palette. They share the window's GL context and the
+ * first panel's font, shaders and slice cache, and the slice a panel shows is
+ * cached once for all of them. The pointer and keys go to the panel last clicked
+ * in.
+ */
+#define MAX_PANELS 4
+
+struct panels {
+	struct state *st[MAX_PANELS];
+	int n;
+	int focus;
+	struct input input; // the window's, handed to the focused panel
+};
+
+void run_panels_frame(struct panels *p)
+{
+	struct input *in = &p->input;
+	pacing_wait();
+	input_poll(in);
+	double frame_start = now_seconds();
+	int w = GetScreenWidth(), h = GetScreenHeight();
+	// the eyedropper's clicks land outside the window
+	if (in->pressed && !p->st[p->focus]->eyedropper) {
+		p->focus = MIN(p->n - 1, MAX(0, (int) in->press_pos.x*p->n / w));
+	}
+	double input_t = in->t;
+	bool held = in->down, accepted = false;
+	for (int i = 0; i < p->n; i++) {
+		held |= p->st[i]->eyedropper;
+	}
+	struct state *first = p->st[0];
+	if (first->low_latency && held != first->uncapped) {
+		set_vsync(!held);
+		first->uncapped = held;
+	}
+	BeginDrawing();
+	for (int i = 0; i < p->n; i++) {
+		struct state *st = p->st[i];
+		st->panel_x = i*w / p->n;
+		st->screenWidth = (i + 1)*w / p->n - st->panel_x;
+		st->screenHeight = h;
+		st->focused = i == p->focus;
+		if (st->focused) {
+			st->input = *in;
+			input_translate(&st->input, -st->panel_x);
+		} else {
+			// nothing happens here, and the pointer is elsewhere
+			memset(&st->input, 0, sizeof(st->input));
+			st->input.pos = (Vector2) { -1, -1 };
+			st->input.t = input_t;
+		}
+		hud_begin_frame(&st->hud);
+		panel_begin(st);
+		draw_ui_and_respond_input(st);
+		hud_count_draw_calls(&st->hud);
+		if (st->hud.visible) {
+			draw_hud(st);
+		}
+		panel_end(st);
+		accepted |= st->accepted;
+	}
+	input_consumed(in);
+	bool idle = !first->continuous && !held && !accepted;
+	if (idle) {
+		EnableEventWaiting();
+	}
+	double swap_start = now_seconds();
+	EndDrawing();
+	pacing_frame_done(frame_start, swap_start, now_seconds(),
+					  idle ? PACE_IDLE : first->uncapped ? PACE_UNCAPPED : PACE_PACED);
+	input_collect(in);
+	for (int i = 0; i < p->n; i++) {
+		struct state *st = p->st[i];
+		st->hud.mark = swap_start; // each panel is charged the swap, not the others' drawing
+		hud_mark(&st->hud, STAGE_SWAP);
+		hud_end_frame(&st->hud, input_t, idle);
+	}
+}
+
+/*
+ * --daemon: keep the window, GL context, font and slice caches alive between
+ * picks. The window stays hidden until a client connects to the socket and sends
+ * "pick". It is then shown until Enter takes the color, which goes back as a hex
+ * line, or Escape or the close button gives up, which closes the connection with
+ * no reply. A plain `cpick` asks the daemon first and opens its own window only
+ * if none answers.
+ */
+#define DAEMON_PICK "pick\n"
+#define DAEMON_TIMEOUT 2 // s a client has to send its request
+
+volatile sig_atomic_t daemon_quit;
+
+void daemon_stop(int sig)
+{
+	(void) sig;
+	daemon_quit = 1;
+}
+
+// $XDG_RUNTIME_DIR is private to the user; /tmp is the fallback
+void daemon_socket_path(struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	if (dir && *dir) {
+		snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/cpick.sock", dir);
+	} else {
+		snprintf(addr->sun_path, sizeof(addr->sun_path), "/tmp/cpick-%d.sock", (int) getuid());
+	}
+}
+
+int daemon_connect(void)
+{
+	struct sockaddr_un addr;
+	daemon_socket_path(&addr);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+		int err = errno;
+		close(fd);
+		errno = err; // for run_daemon, to tell a stale socket from a busy one
+		return -1;
+	}
+	return fd;
+}
+
+// Client side: -1 if no daemon is listening, else the exit status for main.
+int daemon_pick(void)
+{
+	int fd = daemon_connect();
+	if (fd < 0) {
+		return -1;
+	}
+	if (write(fd, DAEMON_PICK, strlen(DAEMON_PICK)) != (ssize_t) strlen(DAEMON_PICK)) {
+		close(fd);
+		return -1;
+	}
+	char reply[64];
+	size_t n = 0;
+	ssize_t r;
+	while (n < sizeof(reply) && (r = read(fd, reply + n, sizeof(reply) - n)) > 0) {
+		n += r;
+	}
+	close(fd);
+	if (n == 0) {
+		return 1; // cancelled
+	}
+	fwrite(reply, 1, n, stdout);
+	return 0;
+}
+
+// Shows the window for one pick, leaving its text in picked; false if it was
+// cancelled.
+bool daemon_serve_pick(struct state *st, char *picked, size_t n)
+{
+	ClearWindowState(FLAG_WINDOW_HIDDEN);
+	SetWindowFocused();
+	// drop whatever queued up while hidden, including last time's close request
+	input_poll(&st->input);
+	input_consumed(&st->input);
+	pacing.mode = PACE_IDLE; // the last frame was long ago, start the first one now
+	st->accepted = false;
+	while (!st->accepted && !daemon_quit && !WindowShouldClose()) {
+		run_frame(st);
+	}
+	if (st->eyedropper) {
+		eyedropper_stop(st, false);
+	}
+	SetWindowState(FLAG_WINDOW_HIDDEN);
+	format_picked(st, picked, n);
+	return st->accepted && !daemon_quit;
+}
+
+// Reads a request line into buf, NUL terminated; false if the client sent no
+// full line in time or one too long for buf.
+bool daemon_read_request(int client, char *buf, size_t n)
+{
+	// a client that connects and says nothing mustn't hold up the next pick
+	struct timeval timeout = { DAEMON_TIMEOUT, 0 };
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	size_t len = 0;
+	while (len < n - 1) {
+		ssize_t r = read(client, buf + len, n - 1 - len);
+		if (r <= 0) {
+			return false;
+		}
+		len += r;
+		buf[len] = 0;
+		if (memchr(buf, '\n', len)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int run_daemon(struct state *st)
+{
+	struct sockaddr_un addr;
+	daemon_socket_path(&addr);
+	int fd = daemon_connect();
+	if (fd >= 0) {
+		close(fd);
+		fprintf(stderr, "cpick: a daemon is already listening on %s\n", addr.sun_path);
+		return 1;
+	}
+	// only a socket nobody listens on is stale; one whose backlog is full still
+	// belongs to a live daemon
+	if (errno != ECONNREFUSED && errno != ENOENT) {
+		fprintf(stderr, "cpick: %s: %s\n", addr.sun_path, strerror(errno));
+		return 1;
+	}
+	unlink(addr.sun_path); // stale, from a daemon that didn't get to clean up
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	mode_t old_mask = umask(077);
+	bool bound = listen_fd >= 0 && !bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr));
+	umask(old_mask);
+	if (!bound || listen(listen_fd, 4)) {
+		perror(addr.sun_path);
+		return 1;
+	}
+	// no SA_RESTART, so a signal breaks out of accept()
+	struct sigaction sa = { 0 };
+	sa.sa_handler = daemon_stop;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN); // a client that gave up shouldn't take us down
+	TraceLog(LOG_INFO, "CPICK: daemon listening on %s", addr.sun_path);
+
+	while (!daemon_quit) {
+		int client = accept(listen_fd, NULL, NULL);
+		if (client < 0) {
+			continue;
+		}
+		char request[16];
+		char reply[64];
+		if (daemon_read_request(client, request, sizeof(request)) && !strcmp(request, DAEMON_PICK) &&
+			daemon_serve_pick(st, reply, sizeof(reply) - 1)) {
+			char *p = reply + strlen(reply);
+			*p++ = '\n';
+			if (write(client, reply, p - reply) < 0) {
+				TraceLog(LOG_WARNING, "CPICK: the client went away before its color");
+			}
+		}
+		close(client);
+	}
+	close(listen_fd);
+	unlink(addr.sun_path);
+	return 0;
 }
 
-int main(void)
+#ifndef CPICK_NO_MAIN
+int main(int argc, char **argv)
 {
 	// Initialization
+	double start_time = now_seconds();
+	bool force_cpu = false;
+	bool continuous = false;
+	bool time_startup = false;
+	bool low_latency = false;
+	const char *export_axis = NULL;
+	const char *export_space = NULL;
+	const char *export_dir = NULL;
+	bool do_convert = false;
+	const char *convert_from = "hex";
+	const char *convert_to = "rgb";
+	const char *palette_file = NULL;
+	bool daemon = false;
+	const char *history_file = NULL;
+	int deep_bits = 0;
+	const char *record_file = NULL;
+	const char *replay_file = NULL;
+	bool replay_fast = false;
+	const char *extract_file = NULL;
+	int extract_k = 8;
+	int npanels = 1;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--cpu")) {
+			force_cpu = true;
+		} else if (!strcmp(argv[i], "--continuous")) {
+			continuous = true;
+		} else if (!strcmp(argv[i], "--time-startup")) {
+			time_startup = true;
+		} else if (!strcmp(argv[i], "--low-latency")) {
+			low_latency = true;
+		} else if (!strcmp(argv[i], "--export-slices") && i + 1 < argc) {
+			export_axis = argv[++i];
+		} else if (!strcmp(argv[i], "--space") && i + 1 < argc) {
+			export_space = argv[++i];
+		} else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+			export_dir = argv[++i];
+		} else if (!strcmp(argv[i], "--convert")) {
+			do_convert = true;
+		} else if (!strcmp(argv[i], "--from") && i + 1 < argc) {
+			convert_from = argv[++i];
+		} else if (!strcmp(argv[i], "--to") && i + 1 < argc) {
+			convert_to = argv[++i];
+		} else if (!strcmp(argv[i], "--palette") && i + 1 < argc) {
+			palette_file = argv[++i];
+		} else if (!strcmp(argv[i], "--daemon")) {
+			daemon = true;
+		} else if (!strcmp(argv[i], "--history") && i + 1 < argc) {
+			history_file = argv[++i];
+		} else if (!strcmp(argv[i], "--bits") && i + 1 < argc &&
+				   (!strcmp(argv[i + 1], "10") || !strcmp(argv[i + 1], "12") || !strcmp(argv[i + 1], "16"))) {
+			deep_bits = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+			record_file = argv[++i];
+		} else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+			replay_file = argv[++i];
+		} else if (!strcmp(argv[i], "--fast")) {
+			replay_fast = true;
+		} else if (!strcmp(argv[i], "--extract") && i + 1 < argc) {
+			extract_file = argv[++i];
+		} else if (!strcmp(argv[i], "-k") && i + 1 < argc && atoi(argv[i + 1]) >= 1 && atoi(argv[i + 1]) <= EXTRACT_MAX_K) {
+			extract_k = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--panels") && i + 1 < argc && atoi(argv[i + 1]) >= 1 && atoi(argv[i + 1]) <= MAX_PANELS) {
+			npanels = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--cpu] [--continuous] [--low-latency] [--time-startup]\n"
+					"       %*s [--bits 10|12|16] [--palette FILE] [--history FILE] [--daemon]\n"
+					"       %*s [--record FILE | --replay FILE [--fast]] [--extract IMAGE [-k 1-32]]\n"
+					"       %*s [--panels 1-4]\n"
+					"       %s --export-slices R|G|B [--space RGB|HSV|HSL|OKLab|OKLCH] [--out DIR]\n"
+					"       %s --convert [--from FORMAT] [--to FORMAT,...] < colors\n"
+					"formats: hex rgb hsv hsl oklab oklch\n",
+					argv[0], (int) strlen(argv[0]), "", (int) strlen(argv[0]), "", (int) strlen(argv[0]), "",
+					argv[0], argv[0]);
+			return 1;
+		}
+	}
+	if ((export_space || export_dir) && !export_axis) {
+		fprintf(stderr, "cpick: --space and --out only go with --export-slices\n");
+		return 1;
+	}
+	if (do_convert) {
+		return convert(convert_from, convert_to);
+	}
+	if (export_axis) {
+		return export_slices(export_space ? export_space : "RGB", export_axis, export_dir ? export_dir : ".");
+	}
+	if ((record_file || replay_file) && (daemon || (record_file && replay_file))) {
+		fprintf(stderr, "cpick: --record and --replay don't combine with --daemon or each other\n");
+		return 1;
+	}
+	if (extract_file && (record_file || replay_file)) {
+		fprintf(stderr, "cpick: --extract doesn't combine with --record or --replay\n");
+		return 1;
+	}
+	if (npanels > 1 && (daemon || record_file || replay_file)) {
+		fprintf(stderr, "cpick: --panels doesn't combine with --daemon, --record or --replay\n");
+		return 1;
+	}
+	if (argc == 1) {
+		int rc = daemon_pick();
+		if (rc >= 0) {
+			return rc;
+		}
+	}
+
 	struct state *st = (struct state *) calloc(1, sizeof(struct state));
-	st->screenWidth = 620;
-	st->screenHeight = 680;
+	if (replay_file && !replay_open(&st->replay, replay_file, replay_fast, &deep_bits)) {
+		return 1;
+	}
+	if (record_file && !record_open(&st->record, record_file, deep_bits)) {
+		return 1;
+	}
+	st->screenWidth = BASE_W;
+	st->screenHeight = BASE_H;
 	st->which_fixed = 0;
 	st->fixed_value = 0;
 	st->x_value = 0;
 	st->y_value = 0;
 	st->text_color = WHITE;
+	st->low_latency = low_latency && !(replay_file && replay_fast); // no vsync to lift
+	// a replay has no events to wait for, and the timed first frame mustn't
+	// wait for one in EndDrawing
+	st->continuous = continuous || replay_file || time_startup;
+	st->deep_bits = deep_bits;
+	st->deep_steps = 1 << deep_bits;
+	st->view_axis = -1;
+	if (!palette_init(&st->palette, palette_file)) {
+		return 1;
+	}
+	if (!record_file && !replay_file) {
+		// a click on a swatch would replay differently with a different history,
+		// so sessions are recorded and replayed without one
+		history_open(&st->history, history_file);
+	}
+	st->extract_k = extract_k;
+	struct panels panels = { .st = { st }, .n = 1, .focus = 0 };
+	for (; panels.n < npanels; panels.n++) {
+		// the same settings, and a mapping of its own of the same history
+		struct state *p = (struct state *) malloc(sizeof(struct state));
+		*p = *st;
+		memset(&p->history, 0, sizeof(p->history));
+		history_open(&p->history, history_file);
+		p->panel = st->panel = true;
+		panels.st[panels.n] = p;
+	}
+	Image extract_img = { 0 };
+	if (extract_file) {
+		extract_img = LoadImage(extract_file);
+		if (!IsImageReady(extract_img)) {
+			fprintf(stderr, "cpick: can't load image %s\n", extract_file);
+			return 1;
+		}
+	}
 
-	SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+	// a fast replay runs as fast as frames can be drawn, not at the refresh rate
+	SetConfigFlags(FLAG_WINDOW_RESIZABLE | (daemon ? FLAG_WINDOW_HIDDEN : 0) |
+				   (replay_file && replay_fast ? 0 : FLAG_VSYNC_HINT));
 	SetTraceLogLevel(LOG_WARNING);
-	InitWindow(st->screenWidth, st->screenHeight, "CPick");
+	InitWindow(npanels*st->screenWidth, st->screenHeight, "CPick");
+#ifndef __APPLE__
+	// macOS scales windows for us; elsewhere start at the monitor's content scale,
+	// the layout follows the window size from there.
+	Vector2 dpi = GetWindowScaleDPI();
+	if (dpi.x > 1 || dpi.y > 1) {
+		SetWindowSize(npanels*BASE_W*dpi.x, BASE_H*dpi.y);
+	}
+#endif
+	SetWindowMinSize(npanels*BASE_W/2, BASE_H/2);
 
 	// to load a font from a ttf file:
 	// st->text_font = LoadFontEx("NotoSansMono.ttf", 120, NULL, 0);
+	double font_start = now_seconds();
 	st->text_font = LoadFont_NotoSansMonoTtf();
+	double font_time = now_seconds() - font_start;
+
+	load_render_resources(st, force_cpu);
+	for (int i = 1; i < panels.n; i++) {
+		share_render_resources(panels.st[i], st);
+	}
+	if (extract_file) {
+		// after load_render_resources, which starts the worker threads
+		extract_to_strip(st, extract_img, extract_k);
+		UnloadImage(extract_img);
+	}
 
-	SetTargetFPS(60); // idk
+	// no frame cap: frames are paced to the monitor, see struct pacing
+	pacing_refresh_rate();
+	if (daemon) {
+		// one frame while hidden, so the first slice, chrome and readout are ready
+		// before the first pick; continuous so EndDrawing doesn't wait for events
+		// that a hidden window never gets
+		st->continuous = true;
+		run_frame(st);
+		st->continuous = continuous;
+		int rc = run_daemon(st);
+		unload_render_resources(st);
+		palette_free(&st->palette);
+		history_close(&st->history);
+		free(st->extracted);
+		CloseWindow();
+		return rc;
+	}
 	// Main game loop
-	while (!WindowShouldClose())
+	bool accepted = false;
+	while (!WindowShouldClose() && !accepted && !st->replay.done)
 	{
-		st->screenWidth = GetScreenWidth();
-		st->screenHeight = GetScreenHeight();
-		// Draw
-		BeginDrawing();
-		draw_ui_and_respond_input(st);
-		EndDrawing();
+		if (panels.n > 1) {
+			run_panels_frame(&panels);
+		} else {
+			run_frame(st);
+		}
+		for (int i = 0; i < panels.n; i++) {
+			accepted |= panels.st[i]->accepted;
+		}
+		if (time_startup) {
+			// EndDrawing has swapped, so the first frame is on its way to the screen
+			fprintf(stderr, "time to first frame: %.1f ms (font: %.1f ms)\n",
+					(now_seconds() - start_time)*1000, font_time*1000);
+			break;
+		}
     }
+	if (st->replay.f) {
+		replay_report(&st->replay, st, replay_file);
+		fclose(st->replay.f);
+		free(st->replay.frame_t);
+	} else if (accepted) {
+		// Enter in any panel prints every panel's color, one per line
+		for (int i = 0; i < panels.n; i++) {
+			char picked[64];
+			format_picked(panels.st[i], picked, sizeof(picked));
+			printf("%s\n", picked);
+		}
+	}
+	if (st->record.f) {
+		fclose(st->record.f);
+	}
 
 	// ExportFontAsCode(st->text_font, "noto_sans_mono_ttf.h");
 	// De-Initialization
+	for (int i = 1; i < panels.n; i++) {
+		unload_panel_resources(panels.st[i]);
+		history_close(&panels.st[i]->history);
+		free(panels.st[i]->extracted);
+		free(panels.st[i]);
+	}
+	unload_render_resources(st);
+	palette_free(&st->palette);
+	history_close(&st->history);
+	free(st->extracted);
 	CloseWindow();        // Close window and OpenGL context
 	return 0;
 }
+#endif